@@ -0,0 +1,176 @@
+﻿/*!
+ * \class CoolQ::ApiMetrics
+ * \brief CoolQ 接口统计
+ *
+ * 记录每个 CQ_* 接口的调用延迟（微秒）和返回的错误码。ServiceModule 的封装函数通过 ApiTimer 自动记录。
+ */
+
+/*!
+ * \class CoolQ::ApiTimer
+ * \brief CoolQ 接口计时
+ *
+ * 构造时开始计时，调用运算符传入接口的返回值时记录一次调用，并原样返回该值。
+ */
+
+#include "CoolQApiMetrics.h"
+#include "CoolQFlightRecorder.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QStringBuilder>
+#include <QTextStream>
+
+#include <algorithm>
+
+namespace CoolQ {
+
+namespace {
+
+struct ApiCounters
+{
+    Histogram latency;
+
+    // 错误很少出现，按错误码计数时加锁即可。
+    QMutex guard;
+    QHash<qint32, quint32> errors;
+};
+
+ApiCounters *counters()
+{
+    static ApiCounters apis[ApiMetrics::ApiCount];
+    return apis;
+}
+
+} // namespace
+
+// class ApiMetrics
+
+/*!
+ * \brief 返回接口 \a api 的名称
+ */
+const char *ApiMetrics::name(Api api)
+{
+    static const char *const names[ApiCount] = {
+        "CQ_sendPrivateMsg",
+        "CQ_sendGroupMsg",
+        "CQ_sendDiscussMsg",
+        "CQ_setGroupBan",
+        "CQ_setGroupKick",
+        "CQ_setGroupAdmin",
+        "CQ_setGroupCard",
+        "CQ_setFriendAddRequest",
+        "CQ_setGroupAddRequestV2",
+        "CQ_setGroupLeave",
+        "CQ_setDiscussLeave",
+        "CQ_setGroupWholeBan",
+        "CQ_getStrangerInfo",
+        "CQ_getGroupMemberInfoV2",
+    };
+
+    return (api >= 0 && api < ApiCount) ? names[api] : "";
+}
+
+/*!
+ * \brief 记录一次调用
+ *
+ * 接口 \a api 用时 \a usecs 微秒，返回 \a result；非 0 的返回值按错误码计数。
+ */
+void ApiMetrics::record(Api api, quint32 usecs, qint32 result)
+{
+    ApiCounters &c = counters()[api];
+    c.latency.record(usecs);
+    FlightRecorder::record(FlightRecorder::Api, quint16(api), 0, result, usecs);
+
+    if (result != 0) {
+        QMutexLocker locker(&c.guard);
+        c.errors[result]++;
+    }
+}
+
+/*!
+ * \brief 返回接口 \a api 的延迟分布
+ */
+Histogram::Snapshot ApiMetrics::latency(Api api)
+{
+    return counters()[api].latency.snapshot();
+}
+
+/*!
+ * \brief 返回接口 \a api 各错误码出现的次数
+ */
+ApiMetrics::ErrorCounts ApiMetrics::errors(Api api)
+{
+    ApiCounters &c = counters()[api];
+
+    ErrorCounts errors;
+    QMutexLocker locker(&c.guard);
+    for (auto i = c.errors.constBegin(); i != c.errors.constEnd(); ++i)
+        errors.append(qMakePair(i.key(), i.value()));
+    std::sort(errors.begin(), errors.end());
+
+    return errors;
+}
+
+/*!
+ * \brief 返回文本形式的统计
+ *
+ * 每个调用过的接口一行：调用次数、平均值、p50、p99、最大值（微秒）以及错误码计数。
+ */
+QString ApiMetrics::report()
+{
+    QString text;
+    QTextStream ts(&text);
+
+    for (int i = 0; i < ApiCount; ++i) {
+        Api api = Api(i);
+        auto s = latency(api);
+        if (s.count == 0)
+            continue;
+
+        ts << name(api) << ": n=" << s.count
+           << " avg=" << s.mean()
+           << " p50=" << s.percentile(0.5)
+           << " p99=" << s.percentile(0.99)
+           << " max=" << s.max << "us";
+
+        auto e = errors(api);
+        if (!e.isEmpty()) {
+            ts << " errors=";
+            for (int j = 0; j < e.count(); ++j) {
+                if (j > 0)
+                    ts << ',';
+                ts << e.at(j).first << 'x' << e.at(j).second;
+            }
+        }
+
+        ts << '\n';
+    }
+
+    ts.flush();
+    return text;
+}
+
+// class ApiTimer
+
+/*!
+ * \brief 记录返回错误码的接口
+ */
+qint32 ApiTimer::operator()(qint32 result)
+{
+    ApiMetrics::record(api, quint32(qMin<qint64>(timer.nsecsElapsed() / 1000, 0xffffffffLL)), result);
+    return result;
+}
+
+/*!
+ * \brief 记录返回数据的接口
+ *
+ * 返回空数据时按错误码 -1 计数。
+ */
+const char *ApiTimer::operator()(const char *result)
+{
+    qint32 code = (result && *result) ? 0 : -1;
+    ApiMetrics::record(api, quint32(qMin<qint64>(timer.nsecsElapsed() / 1000, 0xffffffffLL)), code);
+    return result;
+}
+
+} // namespace CoolQ
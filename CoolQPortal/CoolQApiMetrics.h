@@ -0,0 +1,68 @@
+﻿#ifndef COOLQAPIMETRICS_H
+#define COOLQAPIMETRICS_H
+
+#include <QElapsedTimer>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#include "CoolQHistogram.h"
+
+namespace CoolQ {
+
+// class ApiMetrics
+
+class ApiMetrics
+{
+public:
+    enum Api {
+        SendPrivateMsg,
+        SendGroupMsg,
+        SendDiscussMsg,
+        SetGroupBan,
+        SetGroupKick,
+        SetGroupAdmin,
+        SetGroupCard,
+        SetFriendAddRequest,
+        SetGroupAddRequest,
+        SetGroupLeave,
+        SetDiscussLeave,
+        SetGroupWholeBan,
+        GetStrangerInfo,
+        GetGroupMemberInfo,
+        ApiCount
+    };
+
+    typedef QVector<QPair<qint32, quint32> > ErrorCounts;
+
+public:
+    static const char *name(Api api);
+
+    static void record(Api api, quint32 usecs, qint32 result);
+    static Histogram::Snapshot latency(Api api);
+    static ErrorCounts errors(Api api);
+
+    static QString report();
+};
+
+// class ApiTimer
+
+class ApiTimer
+{
+    Q_DISABLE_COPY(ApiTimer)
+
+public:
+    explicit ApiTimer(ApiMetrics::Api api) : api(api) { timer.start(); }
+
+public:
+    qint32 operator()(qint32 result);
+    const char *operator()(const char *result);
+
+private:
+    ApiMetrics::Api api;
+    QElapsedTimer timer;
+};
+
+} // namespace CoolQ
+
+#endif // COOLQAPIMETRICS_H
@@ -0,0 +1,225 @@
+﻿/*!
+ * \class CoolQ::FlightRecorder
+ * \brief 飞行记录器
+ *
+ * 在固定大小的无锁环形缓冲区中保存最近的事件、分发结果、事件处理和 CoolQ 接口调用。写入只有一次原子加法和几次普通写入，
+ * 在致命错误、关闭 CoolQ 或者收到命令时写成紧凑的二进制文件，用 tools/FlightDecoder 解码。
+ *
+ * 文件格式（小端）：
+ * \list
+ * \li 魔数 "CQFR"、版本 quint16、保留 quint16、开始时间 qint64（毫秒）；
+ * \li 事件、接口、处理三张名称表，各为 quint32 个数加若干 quint16 长度和 UTF-8 字节；
+ * \li quint32 记录数，随后每条记录为 kind quint16、code quint16、value quint32、stamp qint64（微秒）、from qint64、arg qint64。
+ * \endlist
+ */
+
+#include "CoolQFlightRecorder.h"
+
+#include "CoolQApiMetrics.h"
+#include "CoolQHandlerMetrics.h"
+#include "CoolQMetrics.h"
+
+#include <QAtomicInteger>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QSaveFile>
+#include <QVector>
+
+#include <atomic>
+
+namespace CoolQ {
+
+namespace {
+
+const quint32 magic = 0x52465143; // "CQFR"
+const quint16 version = 1;
+
+struct FlightEntry
+{
+    quint16 kind;
+    quint16 code;
+    quint32 value;
+    qint64 stamp;
+    qint64 from;
+    qint64 arg;
+};
+
+struct FlightSlot
+{
+    // 写入完成后为序号加一，读取时据此丢弃正在写入或已被覆盖的记录。
+    QAtomicInteger<quint32> sequence;
+    FlightEntry entry;
+};
+
+struct FlightRing
+{
+    FlightRing()
+    {
+        next.store(0);
+        for (int i = 0; i < FlightRecorder::Capacity; ++i)
+            slots[i].sequence.store(0);
+        epoch = QDateTime::currentMSecsSinceEpoch();
+        timer.start();
+    }
+
+    FlightSlot slots[FlightRecorder::Capacity];
+    QAtomicInteger<quint32> next;
+
+    qint64 epoch;
+    QElapsedTimer timer;
+
+    QMutex guard;
+    QString directory;
+};
+
+FlightRing &ring()
+{
+    static FlightRing r;
+    return r;
+}
+
+void writeNames(QDataStream &ds, const QVector<QByteArray> &names)
+{
+    ds << quint32(names.count());
+    for (const QByteArray &name : names) {
+        ds << quint16(name.size());
+        ds.writeRawData(name.constData(), name.size());
+    }
+}
+
+} // namespace
+
+// class FlightRecorder
+
+/*!
+ * \brief 记录一条
+ *
+ * 记录类型为 \a kind 的一条记录，\a code、\a from、\a arg 和 \a value 的含义由类型决定：
+ * \list
+ * \li Event：事件类型、来源、发送者或成员；
+ * \li Dispatch：事件类型、来源、是否被拦截、分发用时（微秒）；
+ * \li Handler：处理编号、来源、未使用、处理用时（微秒）；
+ * \li Api：接口编号、未使用、返回值、调用用时（微秒）。
+ * \endlist
+ * 此函数可以在任意线程中调用。
+ */
+void FlightRecorder::record(Kind kind, quint16 code, qint64 from, qint64 arg, quint32 value)
+{
+    FlightRing &r = ring();
+
+    quint32 index = r.next.fetchAndAddRelaxed(1);
+    FlightSlot &slot = r.slots[index & (Capacity - 1)];
+
+    // 清零序号必须先于写入内容被看到，单独的 release 存储不能阻止后面的写入提前，这里用完整的交换。
+    slot.sequence.fetchAndStoreOrdered(0);
+    slot.entry.kind = quint16(kind);
+    slot.entry.code = code;
+    slot.entry.value = value;
+    slot.entry.stamp = r.timer.nsecsElapsed() / 1000;
+    slot.entry.from = from;
+    slot.entry.arg = arg;
+    slot.sequence.storeRelease(index + 1);
+}
+
+/*!
+ * \brief 设置转储目录
+ *
+ * dump(const char *) 把文件写入 \a path 目录。
+ */
+void FlightRecorder::setDirectory(const QString &path)
+{
+    FlightRing &r = ring();
+
+    QMutexLocker locker(&r.guard);
+    r.directory = path;
+}
+
+/*!
+ * \brief 返回转储目录
+ */
+QString FlightRecorder::directory()
+{
+    FlightRing &r = ring();
+
+    QMutexLocker locker(&r.guard);
+    return r.directory;
+}
+
+/*!
+ * \brief 转储到文件
+ *
+ * 把缓冲区中的记录写入 \a fileName，返回写入的记录数；失败时返回 -1。记录仍然保留在缓冲区中。
+ */
+int FlightRecorder::dump(const QString &fileName)
+{
+    FlightRing &r = ring();
+
+    QVector<FlightEntry> records;
+    records.reserve(Capacity);
+
+    quint32 last = r.next.loadAcquire();
+    quint32 first = last > quint32(Capacity) ? last - quint32(Capacity) : 0;
+    for (quint32 index = first; index != last; ++index) {
+        const FlightSlot &slot = r.slots[index & (Capacity - 1)];
+        if (slot.sequence.loadAcquire() != index + 1)
+            continue;
+
+        FlightEntry copy = slot.entry;
+
+        // 复制期间被覆盖的记录不可信；再次读取序号之前需要 acquire 栅栏，复制不能被推后。
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load() == index + 1)
+            records.append(copy);
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return -1;
+
+    QDataStream ds(&file);
+    ds.setByteOrder(QDataStream::LittleEndian);
+    ds << magic << version << quint16(0) << r.epoch;
+
+    QVector<QByteArray> events;
+    for (int i = 0; i < Metrics::EventCount; ++i)
+        events.append(Metrics::name(Metrics::Event(i)));
+    QVector<QByteArray> apis;
+    for (int i = 0; i < ApiMetrics::ApiCount; ++i)
+        apis.append(ApiMetrics::name(ApiMetrics::Api(i)));
+
+    writeNames(ds, events);
+    writeNames(ds, apis);
+    writeNames(ds, HandlerMetrics::names());
+
+    ds << quint32(records.count());
+    for (const FlightEntry &e : records)
+        ds << e.kind << e.code << e.value << e.stamp << e.from << e.arg;
+
+    if (ds.status() != QDataStream::Ok || !file.commit())
+        return -1;
+
+    return records.count();
+}
+
+/*!
+ * \brief 转储到转储目录
+ *
+ * 在转储目录中写入以时间和 \a reason 命名的文件，返回文件名；没有设置目录或者写入失败时返回空字符串。
+ */
+QString FlightRecorder::dump(const char *reason)
+{
+    QString path = directory();
+    if (path.isEmpty() || !QDir().mkpath(path))
+        return QString();
+
+    QString fileName = QDir(path).filePath(QString("flight-%1-%2.cqfr")
+                                           .arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss"))
+                                           .arg(QString::fromLatin1(reason)));
+
+    return dump(fileName) < 0 ? QString() : fileName;
+}
+
+} // namespace CoolQ
@@ -0,0 +1,34 @@
+﻿#ifndef COOLQFLIGHTRECORDER_H
+#define COOLQFLIGHTRECORDER_H
+
+#include <QString>
+
+namespace CoolQ {
+
+// class FlightRecorder
+
+class FlightRecorder
+{
+public:
+    enum Kind {
+        Event = 1,
+        Dispatch,
+        Handler,
+        Api
+    };
+
+    enum { Capacity = 4096 };
+
+public:
+    static void record(Kind kind, quint16 code, qint64 from, qint64 arg, quint32 value);
+
+    static void setDirectory(const QString &path);
+    static QString directory();
+
+    static int dump(const QString &fileName);
+    static QString dump(const char *reason);
+};
+
+} // namespace CoolQ
+
+#endif // COOLQFLIGHTRECORDER_H
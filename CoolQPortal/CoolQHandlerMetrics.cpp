@@ -0,0 +1,220 @@
+﻿/*!
+ * \class CoolQ::HandlerMetrics
+ * \brief 事件处理统计
+ *
+ * 按类名记录每个模块和过滤器处理事件的用时（微秒）。超出预算的调用会记录日志，并计入慢调用次数。
+ */
+
+/*!
+ * \class CoolQ::HandlerTimer
+ * \brief 事件处理计时
+ *
+ * 构造时开始计时，析构时记录一次处理。用时超出预算时输出事件类型、来源和关键字。
+ */
+
+#include "CoolQHandlerMetrics.h"
+#include "CoolQFlightRecorder.h"
+#include "CoolQInterface.h"
+
+#include <QHash>
+#include <QMetaObject>
+#include <QMutex>
+#include <QObject>
+#include <QTextStream>
+#include <QtDebug>
+
+#include <algorithm>
+
+namespace CoolQ {
+
+namespace {
+
+struct HandlerRegistry
+{
+    ~HandlerRegistry() { qDeleteAll(handlers); }
+
+    QMutex guard;
+    QHash<QByteArray, HandlerMetrics::Handler *> handlers;
+};
+
+HandlerRegistry *registry()
+{
+    static HandlerRegistry r;
+    return &r;
+}
+
+// 预算以微秒保存，默认 200 毫秒。
+QAtomicInt budgetUsecs(200 * 1000);
+
+} // namespace
+
+// class HandlerMetrics
+
+/*!
+ * \brief 返回名为 \a name 的处理统计
+ *
+ * 同名的处理共用一份统计，返回的指针在插件卸载前一直有效。编号按注册的顺序分配。
+ */
+HandlerMetrics::Handler *HandlerMetrics::handler(const char *name)
+{
+    HandlerRegistry *r = registry();
+    QByteArray key(name);
+
+    QMutexLocker locker(&r->guard);
+    Handler *&h = r->handlers[key];
+    if (!h) {
+        h = new Handler();
+        h->id = quint16(r->handlers.count() - 1);
+        h->name = key;
+        h->slow.store(0);
+    }
+
+    return h;
+}
+
+/*!
+ * \brief 返回对象 \a object 的处理统计
+ *
+ * 第一次调用时按类名查找并保存在 \a cache 中，之后只有一次原子读取。
+ */
+HandlerMetrics::Handler *HandlerMetrics::handler(QAtomicPointer<Handler> &cache, const QObject *object)
+{
+    Handler *h = cache.loadAcquire();
+    if (!h) {
+        h = handler(object->metaObject()->className());
+        cache.storeRelease(h);
+    }
+
+    return h;
+}
+
+/*!
+ * \brief 设置单次处理的预算为 \a msecs 毫秒
+ *
+ * 小于等于 0 时不再记录超时日志。
+ */
+void HandlerMetrics::setBudget(int msecs)
+{
+    budgetUsecs.store(msecs > 0 ? msecs * 1000 : 0);
+}
+
+/*!
+ * \brief 返回单次处理的预算（毫秒）
+ */
+int HandlerMetrics::budget()
+{
+    return budgetUsecs.load() / 1000;
+}
+
+/*!
+ * \brief 返回所有处理的统计
+ */
+QVector<HandlerMetrics::Entry> HandlerMetrics::entries()
+{
+    QVector<Handler *> handlers;
+    do {
+        HandlerRegistry *r = registry();
+        QMutexLocker locker(&r->guard);
+        handlers.reserve(r->handlers.count());
+        for (Handler *h : r->handlers)
+            handlers.append(h);
+    } while (false);
+
+    QVector<Entry> entries;
+    entries.reserve(handlers.count());
+    for (Handler *h : handlers) {
+        Entry e;
+        e.name = h->name;
+        e.latency = h->latency.snapshot();
+        e.slow = h->slow.load();
+        if (e.latency.count > 0)
+            entries.append(e);
+    }
+
+    return entries;
+}
+
+/*!
+ * \brief 返回按编号排列的处理名称
+ */
+QVector<QByteArray> HandlerMetrics::names()
+{
+    HandlerRegistry *r = registry();
+
+    QMutexLocker locker(&r->guard);
+    QVector<QByteArray> names(r->handlers.count());
+    for (Handler *h : r->handlers)
+        names[h->id] = h->name;
+
+    return names;
+}
+
+/*!
+ * \brief 返回文本形式的热点报告
+ *
+ * 按 p99 从高到低列出前 \a count 个处理：调用次数、p50、p99、最大值（毫秒）以及超时次数。
+ * \a count 小于等于 0 时列出全部。
+ */
+QString HandlerMetrics::report(int count)
+{
+    QVector<Entry> entries = HandlerMetrics::entries();
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.latency.percentile(0.99) > b.latency.percentile(0.99);
+    });
+
+    QString text;
+    QTextStream ts(&text);
+    ts.setRealNumberNotation(QTextStream::FixedNotation);
+    ts.setRealNumberPrecision(1);
+
+    if (count <= 0 || count > entries.count())
+        count = entries.count();
+
+    for (int i = 0; i < count; ++i) {
+        const Entry &e = entries.at(i);
+        ts << e.name << ": n=" << e.latency.count
+           << " p50=" << e.latency.percentile(0.5) / 1000.0
+           << " p99=" << e.latency.percentile(0.99) / 1000.0
+           << " max=" << e.latency.max / 1000.0 << "ms";
+        if (e.slow > 0)
+            ts << " slow=" << e.slow;
+        ts << '\n';
+    }
+
+    ts.flush();
+    return text;
+}
+
+// class HandlerTimer
+
+/*!
+ * \brief 析构函数
+ *
+ * 记录本次处理的用时，超出预算时输出日志。
+ */
+HandlerTimer::~HandlerTimer()
+{
+    quint32 usecs = quint32(qMin<qint64>(timer.nsecsElapsed() / 1000, 0xffffffffLL));
+    handler->latency.record(usecs);
+    FlightRecorder::record(FlightRecorder::Handler, handler->id, from, 0, usecs);
+
+    int budget = budgetUsecs.load();
+    if (budget <= 0 || usecs <= quint32(budget))
+        return;
+
+    handler->slow.fetchAndAddRelaxed(1);
+
+    // 只在超时的时候才转换关键字，正常路径上没有额外开销。
+    QString keyword;
+    if (gbkMsg && keywordSize > 0)
+        keyword = trGbk(QByteArray(gbkMsg, keywordSize));
+
+    qWarning().noquote() << QString("Slow handler %1: %2 ms, event=%3 from=%4 keyword=%5")
+                            .arg(QString::fromLatin1(handler->name))
+                            .arg(usecs / 1000.0, 0, 'f', 1)
+                            .arg(QString::fromLatin1(event))
+                            .arg(from)
+                            .arg(keyword.isEmpty() ? QString("-") : keyword);
+}
+
+} // namespace CoolQ
@@ -0,0 +1,72 @@
+﻿#ifndef COOLQHANDLERMETRICS_H
+#define COOLQHANDLERMETRICS_H
+
+#include <QAtomicPointer>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+#include "CoolQHistogram.h"
+
+class QObject;
+
+namespace CoolQ {
+
+// class HandlerMetrics
+
+class HandlerMetrics
+{
+public:
+    struct Handler
+    {
+        quint16 id;
+        QByteArray name;
+        Histogram latency;
+        QAtomicInteger<quint32> slow;
+    };
+
+    struct Entry
+    {
+        QByteArray name;
+        Histogram::Snapshot latency;
+        quint32 slow;
+    };
+
+public:
+    static Handler *handler(const char *name);
+    static Handler *handler(QAtomicPointer<Handler> &cache, const QObject *object);
+
+    static void setBudget(int msecs);
+    static int budget();
+
+    static QVector<Entry> entries();
+    static QVector<QByteArray> names();
+    static QString report(int count = 15);
+};
+
+// class HandlerTimer
+
+class HandlerTimer
+{
+    Q_DISABLE_COPY(HandlerTimer)
+
+public:
+    HandlerTimer(HandlerMetrics::Handler *handler, const char *event, qint64 from,
+                 const char *gbkMsg = nullptr, int keywordSize = 0)
+        : handler(handler), event(event), from(from), gbkMsg(gbkMsg), keywordSize(keywordSize)
+    { timer.start(); }
+    ~HandlerTimer();
+
+private:
+    HandlerMetrics::Handler *handler;
+    const char *event;
+    qint64 from;
+    const char *gbkMsg;
+    int keywordSize;
+    QElapsedTimer timer;
+};
+
+} // namespace CoolQ
+
+#endif // COOLQHANDLERMETRICS_H
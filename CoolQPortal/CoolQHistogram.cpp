@@ -0,0 +1,170 @@
+﻿/*!
+ * \class CoolQ::Histogram
+ * \brief 延迟直方图
+ *
+ * 按对数线性分桶统计非负整数，通常是微秒数。每个线程写入自己的分片，不需要加锁；读取时合并所有分片。
+ */
+
+#include "CoolQHistogram.h"
+
+#include <QtAlgorithms>
+
+namespace CoolQ {
+
+// struct Histogram::Snapshot
+
+/*!
+ * \brief 返回分位数
+ *
+ * 返回 \a q 分位（0 到 1 之间）所在桶的上界，不超过记录到的最大值。
+ */
+quint32 Histogram::Snapshot::percentile(double q) const
+{
+    if (count == 0)
+        return 0;
+
+    quint64 rank = qMax<quint64>(1, quint64(q * count + 0.5));
+    quint64 seen = 0;
+    for (int i = 0; i < counts.count(); ++i) {
+        seen += counts.at(i);
+        if (seen >= rank)
+            return qMin(bucketUpperBound(i), max);
+    }
+
+    return max;
+}
+
+/*!
+ * \brief 返回平均值
+ *
+ * 以各桶的中点估算平均值。
+ */
+quint32 Histogram::Snapshot::mean() const
+{
+    if (count == 0)
+        return 0;
+
+    double sum = 0;
+    for (int i = 0; i < counts.count(); ++i) {
+        if (counts.at(i) > 0)
+            sum += (double(bucketLowerBound(i)) + bucketUpperBound(i)) / 2 * counts.at(i);
+    }
+
+    return quint32(sum / count);
+}
+
+// class Histogram
+
+/*!
+ * \brief 构造函数
+ */
+Histogram::Histogram()
+{
+}
+
+/*!
+ * \brief 析构函数
+ */
+Histogram::~Histogram()
+{
+    qDeleteAll(shards);
+}
+
+/*!
+ * \brief 记录一个值
+ *
+ * 将 \a value 计入当前线程的分片，此函数可以在任意线程中调用。
+ */
+void Histogram::record(quint32 value)
+{
+    Shard *shard = localShard();
+    shard->counts[bucketOf(value)].fetchAndAddRelaxed(1);
+    if (value > shard->max.loadAcquire())
+        shard->max.storeRelease(value);
+}
+
+/*!
+ * \brief 返回合并后的快照
+ */
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot s;
+    s.counts.fill(0, BucketCount);
+    s.count = 0;
+    s.max = 0;
+
+    QMutexLocker locker(&guard);
+    for (const Shard *shard : shards) {
+        for (int i = 0; i < BucketCount; ++i) {
+            quint32 n = shard->counts[i].loadAcquire();
+            s.counts[i] += n;
+            s.count += n;
+        }
+        s.max = qMax(s.max, shard->max.loadAcquire());
+    }
+
+    return s;
+}
+
+/*!
+ * \brief 返回 \a value 所在的桶
+ */
+int Histogram::bucketOf(quint32 value)
+{
+    if (value < SubBuckets)
+        return int(value);
+
+    // 最高位之后的 3 位决定区间内的子桶。
+    int e = 31 - qCountLeadingZeroBits(value);
+    int sub = int(value >> (e - 3)) & (SubBuckets - 1);
+    return qMin((e - 2) * SubBuckets + sub, BucketCount - 1);
+}
+
+/*!
+ * \brief 返回桶 \a bucket 的下界
+ */
+quint32 Histogram::bucketLowerBound(int bucket)
+{
+    if (bucket < SubBuckets)
+        return quint32(bucket);
+
+    int e = bucket / SubBuckets + 2;
+    int sub = bucket % SubBuckets;
+    return quint32(SubBuckets + sub) << (e - 3);
+}
+
+/*!
+ * \brief 返回桶 \a bucket 的上界
+ */
+quint32 Histogram::bucketUpperBound(int bucket)
+{
+    if (bucket < SubBuckets)
+        return quint32(bucket);
+
+    int e = bucket / SubBuckets + 2;
+    int sub = bucket % SubBuckets;
+    return (quint32(SubBuckets + sub + 1) << (e - 3)) - 1;
+}
+
+/*!
+ * \internal
+ *
+ * 分片在线程第一次写入时创建，线程退出后保留，计数不会丢失。
+ */
+Histogram::Shard *Histogram::localShard()
+{
+    LocalShard &local = this->local.localData();
+    if (!local.shard) {
+        local.shard = new Shard();
+        for (int i = 0; i < BucketCount; ++i)
+            local.shard->counts[i].store(0);
+        local.shard->max.store(0);
+
+        QMutexLocker locker(&guard);
+        shards.append(local.shard);
+    }
+
+    return local.shard;
+}
+
+} // namespace CoolQ
@@ -0,0 +1,70 @@
+﻿#ifndef COOLQHISTOGRAM_H
+#define COOLQHISTOGRAM_H
+
+#include <QAtomicInteger>
+#include <QList>
+#include <QMutex>
+#include <QThreadStorage>
+#include <QVector>
+
+namespace CoolQ {
+
+// class Histogram
+
+class Histogram
+{
+    Q_DISABLE_COPY(Histogram)
+
+public:
+    Histogram();
+    ~Histogram();
+
+public:
+    // 对数线性分桶：每个 2 的幂区间再等分为 SubBuckets 份，相对误差不超过 12.5%。
+    enum {
+        SubBuckets = 8,
+        BucketCount = SubBuckets * 30
+    };
+
+    struct Snapshot
+    {
+        QVector<quint32> counts;
+        quint32 count;
+        quint32 max;
+
+        quint32 percentile(double q) const;
+        quint32 mean() const;
+    };
+
+public:
+    void record(quint32 value);
+    Snapshot snapshot() const;
+
+    static int bucketOf(quint32 value);
+    static quint32 bucketLowerBound(int bucket);
+    static quint32 bucketUpperBound(int bucket);
+
+private:
+    struct Shard
+    {
+        QAtomicInteger<quint32> counts[BucketCount];
+        QAtomicInteger<quint32> max;
+    };
+
+    struct LocalShard
+    {
+        Shard *shard = nullptr;
+    };
+
+    Shard *localShard();
+
+private:
+    // 每个线程只写自己的分片，读取时合并所有分片。
+    mutable QMutex guard;
+    QList<Shard *> shards;
+    QThreadStorage<LocalShard> local;
+};
+
+} // namespace CoolQ
+
+#endif // COOLQHISTOGRAM_H
@@ -0,0 +1,454 @@
+﻿/*!
+ * \class CoolQ::ImageCollector
+ * \brief 图片目录回收类
+ *
+ * 在低优先级的后台线程中定期扫描 CoolQ 待发送图片目录，按最近访问时间淘汰文件，直到总字节数和文件数都不超过限额。最近被引用过的文件和被固定的文件不会被删除。
+ */
+
+#include "CoolQImageCollector.h"
+#include "CoolQImageCollector_p.h"
+
+#include <QDateTime>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QVector>
+
+#include <algorithm>
+#include <limits>
+
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(qlcImageCollector, "CoolQ::ImageCollector")
+
+namespace CoolQ {
+
+// 每批删除的文件数，以及两批之间让出的时间。
+static const int batchSize = 32;
+static const int batchPause = 50;
+
+// class ImageCollector
+
+/*!
+ * \brief 构造函数
+ *
+ * 回收 \a path 目录中的文件，回收线程随之启动。
+ */
+ImageCollector::ImageCollector(const QString &path, QObject *parent)
+    : Interface(*new ImageCollectorPrivate(), parent)
+{
+    Q_D(ImageCollector);
+    d->path = path;
+    d->thread = new ImageCollectorThread(d);
+    d->thread->start(QThread::LowestPriority);
+}
+
+/*!
+ * \brief 析构函数
+ *
+ * 停止回收线程，正在进行的回收会在当前批次结束后退出。
+ */
+ImageCollector::~ImageCollector()
+{
+    Q_D(ImageCollector);
+
+    do {
+        QMutexLocker locker(&d->guard);
+        d->stopping = true;
+        d->wakeup.wakeAll();
+    } while (false);
+
+    d->thread->wait();
+    delete d->thread;
+}
+
+/*!
+ * \brief 返回回收的目录
+ */
+QString ImageCollector::path() const
+{
+    Q_D(const ImageCollector);
+    return d->path;
+}
+
+/*!
+ * \brief 返回目录的字节数上限
+ */
+qint64 ImageCollector::maxBytes() const
+{
+    Q_D(const ImageCollector);
+
+    QMutexLocker locker(&d->guard);
+    return d->maxBytes;
+}
+
+/*!
+ * \brief 设置目录的字节数上限
+ *
+ * 目录中文件的总字节数超过 \a maxBytes 时开始淘汰。
+ */
+void ImageCollector::setMaxBytes(qint64 maxBytes)
+{
+    Q_D(ImageCollector);
+
+    QMutexLocker locker(&d->guard);
+    d->maxBytes = qMax<qint64>(0, maxBytes);
+}
+
+/*!
+ * \brief 返回目录的文件数上限
+ */
+int ImageCollector::maxFiles() const
+{
+    Q_D(const ImageCollector);
+
+    QMutexLocker locker(&d->guard);
+    return d->maxFiles;
+}
+
+/*!
+ * \brief 设置目录的文件数上限
+ *
+ * 目录中的文件数超过 \a maxFiles 时开始淘汰。
+ */
+void ImageCollector::setMaxFiles(int maxFiles)
+{
+    Q_D(ImageCollector);
+
+    QMutexLocker locker(&d->guard);
+    d->maxFiles = qMax(0, maxFiles);
+}
+
+/*!
+ * \brief 返回保护时间
+ */
+int ImageCollector::protectMinutes() const
+{
+    Q_D(const ImageCollector);
+
+    QMutexLocker locker(&d->guard);
+    return d->protectMinutes;
+}
+
+/*!
+ * \brief 设置保护时间
+ *
+ * 最近 \a minutes 分钟内写入或引用过的文件不会被删除，即使目录超过限额，也包括清理缓存命令。
+ * \sa ImageCollector::touch
+ */
+void ImageCollector::setProtectMinutes(int minutes)
+{
+    Q_D(ImageCollector);
+
+    QMutexLocker locker(&d->guard);
+    d->protectMinutes = qMax(0, minutes);
+}
+
+/*!
+ * \brief 返回回收间隔
+ */
+int ImageCollector::interval() const
+{
+    Q_D(const ImageCollector);
+
+    QMutexLocker locker(&d->guard);
+    return d->interval;
+}
+
+/*!
+ * \brief 设置回收间隔
+ *
+ * 每隔 \a seconds 秒检查一次目录。
+ */
+void ImageCollector::setInterval(int seconds)
+{
+    Q_D(ImageCollector);
+
+    QMutexLocker locker(&d->guard);
+    d->interval = qMax(1, seconds);
+    d->wakeup.wakeAll();
+}
+
+/*!
+ * \brief 标记文件被引用
+ *
+ * 记录文件 \a fileName 刚被使用，在保护时间内不会被回收。此函数可以在任意线程中调用。
+ */
+void ImageCollector::touch(const QString &fileName)
+{
+    Q_D(ImageCollector);
+
+    if (fileName.isEmpty())
+        return;
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    QMutexLocker locker(&d->guard);
+    d->touched.insert(fileName, now);
+}
+
+/*!
+ * \brief 固定文件
+ *
+ * 固定的文件 \a fileName 在取消固定之前不会被回收，也不会被清理目录删除。同一个文件可以被固定多次，需要相同次数的 unpin() 才会解除。此函数可以在任意线程中调用。
+ * \sa ImageCollector::unpin
+ */
+void ImageCollector::pin(const QString &fileName)
+{
+    Q_D(ImageCollector);
+
+    if (fileName.isEmpty())
+        return;
+
+    QMutexLocker locker(&d->guard);
+    d->pinned[fileName]++;
+}
+
+/*!
+ * \brief 取消固定文件
+ *
+ * 撤销一次对 \a fileName 的 pin()，并按刚被引用处理，文件仍会受保护时间保护。
+ */
+void ImageCollector::unpin(const QString &fileName)
+{
+    Q_D(ImageCollector);
+
+    if (fileName.isEmpty())
+        return;
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    QMutexLocker locker(&d->guard);
+    auto i = d->pinned.find(fileName);
+    if (i != d->pinned.end() && --i.value() <= 0)
+        d->pinned.erase(i);
+    d->touched.insert(fileName, now);
+}
+
+/*!
+ * \brief 立即回收
+ *
+ * 唤醒回收线程检查一次目录，不等待回收完成。
+ */
+void ImageCollector::collect()
+{
+    Q_D(ImageCollector);
+
+    QMutexLocker locker(&d->guard);
+    d->pending = true;
+    d->wakeup.wakeAll();
+}
+
+/*!
+ * \brief 清理目录
+ *
+ * 在回收线程中删除保护时间以外的全部文件，不等待清理完成。
+ */
+void ImageCollector::purge()
+{
+    Q_D(ImageCollector);
+
+    QMutexLocker locker(&d->guard);
+    d->pending = true;
+    d->purging = true;
+    d->wakeup.wakeAll();
+}
+
+/*!
+ * \brief 返回回收统计
+ *
+ * 返回最近一次扫描后目录中剩余的文件数和字节数，以及累计删除的文件数、字节数和回收次数。
+ */
+ImageCollector::Metrics ImageCollector::metrics() const
+{
+    Q_D(const ImageCollector);
+
+    QMutexLocker locker(&d->guard);
+    return d->metrics;
+}
+
+// class ImageCollectorThread
+
+/*!
+ * \internal
+ */
+void ImageCollectorThread::run()
+{
+    d->run();
+}
+
+// class ImageCollectorPrivate
+
+/*!
+ * \internal
+ */
+ImageCollectorPrivate::ImageCollectorPrivate()
+    : thread(nullptr)
+    , stopping(false)
+    , pending(false)
+    , purging(false)
+    , maxBytes(Q_INT64_C(256) * 1024 * 1024)
+    , maxFiles(4096)
+    , protectMinutes(30)
+    , interval(300)
+{
+    metrics.files = 0;
+    metrics.bytes = 0;
+    metrics.removedFiles = 0;
+    metrics.removedBytes = 0;
+    metrics.passes = 0;
+}
+
+/*!
+ * \internal
+ */
+ImageCollectorPrivate::~ImageCollectorPrivate()
+{
+}
+
+/*!
+ * \internal
+ *
+ * 回收线程的主循环，等待间隔到期或被唤醒。
+ */
+void ImageCollectorPrivate::run()
+{
+    QMutexLocker locker(&guard);
+
+    while (!stopping) {
+        if (!pending)
+            wakeup.wait(&guard, static_cast<unsigned long>(interval) * 1000);
+        if (stopping)
+            break;
+
+        bool purge = purging;
+        pending = false;
+        purging = false;
+
+        locker.unlock();
+        collect(purge);
+        locker.relock();
+    }
+}
+
+/*!
+ * \internal
+ *
+ * 扫描一次目录。\a purging 为 true 时删除保护时间以外的全部文件，否则只删除到不超过限额为止。
+ */
+void ImageCollectorPrivate::collect(bool purging)
+{
+    struct Entry {
+        QString fileName;
+        qint64 size;
+        qint64 used;
+    };
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    qint64 maxBytes;
+    int maxFiles;
+    qint64 protectedSince;
+    QHash<QString, qint64> touched;
+    do {
+        QMutexLocker locker(&guard);
+        maxBytes = this->maxBytes;
+        maxFiles = this->maxFiles;
+        protectedSince = now - qint64(protectMinutes) * 60 * 1000;
+
+        // 超过保护时间的引用记录已经没有作用。
+        for (auto i = this->touched.begin(); i != this->touched.end();) {
+            if (i.value() < protectedSince) {
+                i = this->touched.erase(i);
+            } else {
+                ++i;
+            }
+        }
+        touched = this->touched;
+        for (auto i = pinned.constBegin(); i != pinned.constEnd(); ++i)
+            touched.insert(i.key(), std::numeric_limits<qint64>::max());
+    } while (false);
+
+    // 只处理图片目录本身的文件，子目录由各个模块自己管理。
+    QVector<Entry> entries;
+    qint64 bytes = 0;
+    QDirIterator it(path, QDir::Files);
+    while (it.hasNext()) {
+        it.next();
+        QFileInfo fileInfo = it.fileInfo();
+
+        // 访问时间可能没有开启，取访问时间和修改时间中较晚的一个。
+        Entry entry;
+        entry.fileName = fileInfo.fileName();
+        entry.size = fileInfo.size();
+        entry.used = qMax(fileInfo.lastRead().toMSecsSinceEpoch(), fileInfo.lastModified().toMSecsSinceEpoch());
+        entry.used = qMax(entry.used, touched.value(entry.fileName));
+        entries.append(entry);
+        bytes += entry.size;
+    }
+
+    int files = entries.count();
+    int removedFiles = 0;
+    qint64 removedBytes = 0;
+
+    if (purging || bytes > maxBytes || files > maxFiles) {
+        std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+            return a.used < b.used;
+        });
+
+        // 按最近使用时间从旧到新删除，每批之间让出时间，避免长时间占用磁盘。
+        for (int i = 0; i < entries.count(); ++i) {
+            if (!purging && bytes <= maxBytes && files <= maxFiles)
+                break;
+
+            const Entry &entry = entries.at(i);
+            if (entry.used >= protectedSince)
+                break;
+
+            // 扫描之后文件可能又被引用或固定，删除前在锁内重新检查，检查和删除之间不会插入新的引用。
+            bool removed = false;
+            do {
+                QMutexLocker locker(&guard);
+                if (pinned.contains(entry.fileName) || this->touched.value(entry.fileName) >= protectedSince)
+                    break;
+                removed = QFile::remove(path + '/' + entry.fileName);
+            } while (false);
+
+            if (removed) {
+                bytes -= entry.size;
+                files--;
+                removedBytes += entry.size;
+                removedFiles++;
+            }
+
+            if ((i + 1) % batchSize == 0) {
+                if (isStopping())
+                    break;
+                QThread::msleep(batchPause);
+            }
+        }
+    }
+
+    if (removedFiles > 0) {
+        qCInfo(qlcImageCollector, "Removed %d files, %lld bytes; %d files, %lld bytes left.",
+               removedFiles, removedBytes, files, bytes);
+    }
+
+    QMutexLocker locker(&guard);
+    metrics.files = files;
+    metrics.bytes = bytes;
+    metrics.removedFiles += removedFiles;
+    metrics.removedBytes += removedBytes;
+    metrics.passes++;
+}
+
+/*!
+ * \internal
+ */
+bool ImageCollectorPrivate::isStopping()
+{
+    QMutexLocker locker(&guard);
+    return stopping;
+}
+
+} // namespace CoolQ
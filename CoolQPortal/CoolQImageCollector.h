@@ -0,0 +1,55 @@
+﻿#ifndef COOLQIMAGECOLLECTOR_H
+#define COOLQIMAGECOLLECTOR_H
+
+#include "CoolQInterface.h"
+
+namespace CoolQ {
+
+class ImageCollectorPrivate;
+class ImageCollector : public Interface
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(ImageCollector)
+
+public:
+    explicit ImageCollector(const QString &path, QObject *parent);
+public:
+    virtual ~ImageCollector();
+
+public:
+    struct Metrics {
+        int files;
+        qint64 bytes;
+        int removedFiles;
+        qint64 removedBytes;
+        int passes;
+    };
+
+public:
+    QString path() const;
+
+    qint64 maxBytes() const;
+    void setMaxBytes(qint64 maxBytes);
+
+    int maxFiles() const;
+    void setMaxFiles(int maxFiles);
+
+    int protectMinutes() const;
+    void setProtectMinutes(int minutes);
+
+    int interval() const;
+    void setInterval(int seconds);
+
+public:
+    void touch(const QString &fileName);
+    void pin(const QString &fileName);
+    void unpin(const QString &fileName);
+    void collect();
+    void purge();
+
+    Metrics metrics() const;
+};
+
+} // namespace CoolQ
+
+#endif // COOLQIMAGECOLLECTOR_H
@@ -0,0 +1,62 @@
+﻿#ifndef CQIMAGECOLLECTOR_P_H
+#define CQIMAGECOLLECTOR_P_H
+
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "CoolQInterface_p.h"
+#include "CoolQImageCollector.h"
+
+namespace CoolQ {
+
+class ImageCollectorPrivate;
+class ImageCollectorThread : public QThread
+{
+public:
+    explicit ImageCollectorThread(ImageCollectorPrivate *d) : d(d) {}
+
+protected:
+    virtual void run() override;
+
+private:
+    ImageCollectorPrivate *d;
+};
+
+class ImageCollectorPrivate : public InterfacePrivate
+{
+    Q_DECLARE_PUBLIC(ImageCollector)
+
+public:
+    ImageCollectorPrivate();
+    virtual ~ImageCollectorPrivate();
+
+public:
+    void run();
+    void collect(bool purging);
+    bool isStopping();
+
+public:
+    QString path;
+    ImageCollectorThread *thread;
+
+    mutable QMutex guard;
+    QWaitCondition wakeup;
+    bool stopping;
+    bool pending;
+    bool purging;
+
+    qint64 maxBytes;
+    int maxFiles;
+    int protectMinutes;
+    int interval;
+
+    QHash<QString, qint64> touched;
+    QHash<QString, int> pinned;
+    ImageCollector::Metrics metrics;
+};
+
+} // namespace CoolQ
+
+#endif // CQIMAGECOLLECTOR_P_H
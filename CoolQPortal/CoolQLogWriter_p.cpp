@@ -0,0 +1,221 @@
+﻿#include "CoolQLogWriter_p.h"
+#include "CoolQServiceEngine_p.h"
+
+#include <QDateTime>
+
+#include "CoolQApi/CoolQLib.h"
+
+namespace CoolQ {
+
+// 写入间隔、每批的最大长度，以及每秒允许调用 CQ_addLog 的次数和突发上限。
+static const int flushInterval = 100;
+static const int maxBatchSize = 4000;
+static const double ratePerSecond = 20;
+static const double rateBurst = 50;
+
+static const char logCategory[] = "Qt Logs";
+
+// class LogWriterThread
+
+void LogWriterThread::run()
+{
+    writer->run();
+}
+
+// class LogWriter
+
+LogWriter::LogWriter()
+    : enqueuePos(0)
+    , dequeuePos(0)
+    , dropped(0)
+    , running(0)
+    , stopping(0)
+    , thread(nullptr)
+    , lastRefill(0)
+    , tokens(rateBurst)
+    , suppressed(0)
+    , lost(0)
+{
+    for (quint32 i = 0; i < Capacity; ++i)
+        slots[i].sequence.store(i);
+}
+
+LogWriter::~LogWriter()
+{
+    // 不在这里停止写入线程：卸载 DLL 时持有加载器锁，等待线程会死锁。
+    // 写入线程由 __systemShutdownEvent 停止。
+}
+
+LogWriter *LogWriter::instance()
+{
+    static LogWriter writer;
+    return &writer;
+}
+
+void LogWriter::start()
+{
+    if (thread)
+        return;
+
+    thread = new LogWriterThread(this);
+    running.store(1);
+    thread->start(QThread::LowPriority);
+}
+
+void LogWriter::stop()
+{
+    if (!thread)
+        return;
+
+    // 先切换到同步写入，等待期间产生的日志不再进入队列；写入线程退出后把队列里剩下的写完。
+    running.store(0);
+    stopping.store(1);
+    thread->wait();
+    delete thread;
+    thread = nullptr;
+
+    drain();
+}
+
+void LogWriter::post(qint32 priority, const QByteArray &text)
+{
+    if (!running.load()) {
+        write(priority, text);
+        return;
+    }
+
+    // 队列已满时丢弃，不阻塞产生日志的线程，丢弃的数量稍后汇总报告。
+    if (!push(priority, text))
+        dropped.ref();
+}
+
+void LogWriter::fatal(const QByteArray &text, const QByteArray &gbkMsg)
+{
+    // 先等写入线程把之前的日志写完，再同步写入致命错误。
+    if (running.load()) {
+        for (int i = 0; i < 200 && dequeuePos.load() != enqueuePos.load(); ++i)
+            QThread::msleep(1);
+    }
+
+    write(CQLOG_FATAL, text);
+    CQ_setFatal(ServiceEnginePrivate::accessToken, gbkMsg.constData());
+}
+
+bool LogWriter::push(qint32 priority, const QByteArray &text)
+{
+    quint32 pos = enqueuePos.load();
+    Slot *slot = nullptr;
+
+    forever {
+        slot = &slots[pos & (Capacity - 1)];
+        qint32 diff = qint32(slot->sequence.loadAcquire() - pos);
+        if (diff == 0) {
+            if (enqueuePos.testAndSetRelaxed(pos, pos + 1))
+                break;
+            pos = enqueuePos.load();
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = enqueuePos.load();
+        }
+    }
+
+    slot->record.priority = priority;
+    slot->record.text = text;
+    slot->sequence.storeRelease(pos + 1);
+    return true;
+}
+
+bool LogWriter::pop(Record *record)
+{
+    quint32 pos = dequeuePos.load();
+    Slot *slot = &slots[pos & (Capacity - 1)];
+    if (qint32(slot->sequence.loadAcquire() - (pos + 1)) < 0)
+        return false;
+
+    record->priority = slot->record.priority;
+    record->text.swap(slot->record.text);
+    slot->record.text.clear();
+    slot->sequence.storeRelease(pos + Capacity);
+    dequeuePos.storeRelease(pos + 1);
+    return true;
+}
+
+void LogWriter::run()
+{
+    while (!stopping.load()) {
+        QThread::msleep(flushInterval);
+        drain();
+    }
+}
+
+void LogWriter::drain()
+{
+    QVector<Record> records;
+    Record record;
+    while (pop(&record))
+        records.append(record);
+
+    lost += dropped.fetchAndStoreRelaxed(0);
+    if (records.isEmpty() && lost == 0 && suppressed == 0)
+        return;
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (lastRefill > 0)
+        tokens = qMin(rateBurst, tokens + (now - lastRefill) * ratePerSecond / 1000);
+    lastRefill = now;
+
+    // 连续重复的日志只写一次，并注明重复次数。
+    QVector<Record> lines;
+    for (int i = 0; i < records.count();) {
+        int j = i + 1;
+        while (j < records.count() && records.at(j).priority == records.at(i).priority
+               && records.at(j).text == records.at(i).text) {
+            ++j;
+        }
+
+        Record line = records.at(i);
+        if (j - i > 1)
+            line.text += " (x" + QByteArray::number(j - i) + ")";
+        lines.append(line);
+        i = j;
+    }
+
+    // 相同级别的相邻日志合并成一次调用，超过速率限制的批次被丢弃。警告及以上的日志不受限制，也不消耗配额。
+    for (int i = 0; i < lines.count();) {
+        QByteArray batch = lines.at(i).text;
+        int j = i + 1;
+        while (j < lines.count() && lines.at(j).priority == lines.at(i).priority
+               && batch.size() + lines.at(j).text.size() < maxBatchSize) {
+            batch += '\n';
+            batch += lines.at(j).text;
+            ++j;
+        }
+
+        if (lines.at(i).priority >= CQLOG_WARNING) {
+            write(lines.at(i).priority, batch);
+        } else if (tokens >= 1 || !running.load()) {
+            tokens -= 1;
+            write(lines.at(i).priority, batch);
+        } else {
+            suppressed += j - i;
+        }
+        i = j;
+    }
+
+    if ((suppressed > 0 || lost > 0) && (tokens >= 1 || !running.load())) {
+        tokens -= 1;
+        QByteArray text = "Log writer: " + QByteArray::number(suppressed) + " messages rate-limited, "
+                + QByteArray::number(lost) + " dropped on a full queue.";
+        write(CQLOG_WARNING, text);
+        suppressed = 0;
+        lost = 0;
+    }
+}
+
+void LogWriter::write(qint32 priority, const QByteArray &text)
+{
+    CQ_addLog(ServiceEnginePrivate::accessToken, priority, logCategory, text.constData());
+}
+
+} // namespace CoolQ
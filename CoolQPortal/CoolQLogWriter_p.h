@@ -0,0 +1,85 @@
+﻿#ifndef CQLOGWRITER_P_H
+#define CQLOGWRITER_P_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QThread>
+#include <QVector>
+
+namespace CoolQ {
+
+class LogWriter;
+class LogWriterThread : public QThread
+{
+public:
+    explicit LogWriterThread(LogWriter *writer) : writer(writer) {}
+
+protected:
+    virtual void run() override;
+
+private:
+    LogWriter *writer;
+};
+
+// 异步日志：任意线程把格式化好的日志放入无锁环形队列，由单独的线程合并后写入 CoolQ。
+class LogWriter
+{
+    Q_DISABLE_COPY(LogWriter)
+
+public:
+    LogWriter();
+    ~LogWriter();
+
+public:
+    static LogWriter *instance();
+
+    void start();
+    void stop();
+
+    void post(qint32 priority, const QByteArray &text);
+    void fatal(const QByteArray &text, const QByteArray &gbkMsg);
+
+private:
+    struct Record
+    {
+        qint32 priority;
+        QByteArray text;
+    };
+
+    struct Slot
+    {
+        QAtomicInteger<quint32> sequence;
+        Record record;
+    };
+
+    enum { Capacity = 4096 };
+
+    bool push(qint32 priority, const QByteArray &text);
+    bool pop(Record *record);
+
+    void run();
+    void drain();
+    void write(qint32 priority, const QByteArray &text);
+
+private:
+    Slot slots[Capacity];
+    QAtomicInteger<quint32> enqueuePos;
+    QAtomicInteger<quint32> dequeuePos;
+    QAtomicInt dropped;
+
+    QAtomicInt running;
+    QAtomicInt stopping;
+    LogWriterThread *thread;
+
+    // 以下只在写入线程中使用。
+    qint64 lastRefill;
+    double tokens;
+    int suppressed;
+    int lost;
+
+    friend class LogWriterThread;
+};
+
+} // namespace CoolQ
+
+#endif // CQLOGWRITER_P_H
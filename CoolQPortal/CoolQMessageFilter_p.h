@@ -1,6 +1,7 @@
 ﻿#ifndef COOLQMESSAGEFILTER_P_H
 #define COOLQMESSAGEFILTER_P_H
 
+#include "CoolQHandlerMetrics.h"
 #include "CoolQInterface_p.h"
 #include "CoolQMessageFilter.h"
 
@@ -14,9 +15,15 @@ public:
     MessageFilterPrivate();
     virtual ~MessageFilterPrivate();
 
+public:
+    static MessageFilterPrivate *get(MessageFilter *o) { return o ? o->d_func() : nullptr; }
+
 protected:
     ServiceEngine *engine;
     ServiceModule *module;
+
+public:
+    QAtomicPointer<HandlerMetrics::Handler> handlerMetrics;
 };
 
 } // namespace CoolQ
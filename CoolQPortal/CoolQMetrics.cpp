@@ -0,0 +1,354 @@
+﻿/*!
+ * \class CoolQ::Metrics
+ * \brief 运行统计
+ *
+ * 汇总插件运行状态的统计中心。事件计数和分发延迟由 ServiceEngine 通过 EventTimer 记录，
+ * 每个线程写入自己的分片；其它子系统通过 addSource() 注册数据源，在读取时才采集数值。
+ */
+
+/*!
+ * \class CoolQ::EventTimer
+ * \brief 事件分发计时
+ *
+ * 构造时开始计时，析构时记录一次事件分发。
+ */
+
+#include "CoolQMetrics.h"
+#include "CoolQFlightRecorder.h"
+
+#include <QAtomicInteger>
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QThreadStorage>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+namespace CoolQ {
+
+namespace {
+
+struct GroupShard
+{
+    QMutex guard;
+    QHash<qint64, quint32> counts;
+};
+
+struct LocalGroupShard
+{
+    GroupShard *shard = nullptr;
+};
+
+struct MetricsRegistry
+{
+    MetricsRegistry()
+    {
+        for (int i = 0; i < Metrics::EventCount; ++i) {
+            counts[i].store(0);
+            lastCounts[i] = 0;
+            prevCounts[i] = 0;
+        }
+        startTime = QDateTime::currentMSecsSinceEpoch();
+        lastTime = 0;
+        prevTime = 0;
+    }
+
+    ~MetricsRegistry() { qDeleteAll(shards); }
+
+    QAtomicInteger<quint32> counts[Metrics::EventCount];
+    Histogram latency[Metrics::EventCount];
+
+    // 每个线程只写自己的分组计数，分片的锁只在读取时才会竞争。
+    QMutex shardsGuard;
+    QList<GroupShard *> shards;
+    QThreadStorage<LocalGroupShard> local;
+
+    QMutex sampleGuard;
+    qint64 startTime;
+    qint64 lastTime;
+    qint64 prevTime;
+    quint32 lastCounts[Metrics::EventCount];
+    quint32 prevCounts[Metrics::EventCount];
+
+    QMutex sourcesGuard;
+    QVector<QPair<const QObject *, Metrics::Source> > sources;
+};
+
+MetricsRegistry *registry()
+{
+    static MetricsRegistry r;
+    return &r;
+}
+
+GroupShard *localGroupShard()
+{
+    MetricsRegistry *r = registry();
+    LocalGroupShard &local = r->local.localData();
+    if (!local.shard) {
+        local.shard = new GroupShard();
+
+        QMutexLocker locker(&r->shardsGuard);
+        r->shards.append(local.shard);
+    }
+
+    return local.shard;
+}
+
+bool isGroupEvent(Metrics::Event event)
+{
+    switch (event) {
+    case Metrics::GroupMessage:
+    case Metrics::MasterChange:
+    case Metrics::GroupRequest:
+    case Metrics::MemberJoin:
+    case Metrics::MemberLeave:
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+// class Metrics
+
+/*!
+ * \brief 开始计时
+ *
+ * 由 ServiceEngine 在构造时调用，运行时间从此时算起。
+ */
+void Metrics::start()
+{
+    MetricsRegistry *r = registry();
+
+    QMutexLocker locker(&r->sampleGuard);
+    r->startTime = QDateTime::currentMSecsSinceEpoch();
+}
+
+/*!
+ * \brief 返回运行时间（毫秒）
+ */
+qint64 Metrics::uptime()
+{
+    MetricsRegistry *r = registry();
+
+    QMutexLocker locker(&r->sampleGuard);
+    return QDateTime::currentMSecsSinceEpoch() - r->startTime;
+}
+
+/*!
+ * \brief 返回进程占用的私有内存（字节）
+ *
+ * 不支持的平台上返回 -1。
+ */
+qint64 Metrics::memoryUsage()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return qint64(pmc.PagefileUsage);
+#endif
+    return -1;
+}
+
+/*!
+ * \brief 返回事件 \a event 的名称
+ */
+const char *Metrics::name(Event event)
+{
+    static const char *const names[EventCount] = {
+        "private_message",
+        "group_message",
+        "discuss_message",
+        "master_change",
+        "friend_request",
+        "group_request",
+        "friend_add",
+        "member_join",
+        "member_leave",
+    };
+
+    return (event >= 0 && event < EventCount) ? names[event] : "";
+}
+
+/*!
+ * \brief 记录一次事件
+ *
+ * 来自 \a from 的事件 \a event 分发用时 \a usecs 微秒。群组相关的事件还会按群组计数。
+ */
+void Metrics::record(Event event, qint64 from, quint32 usecs)
+{
+    MetricsRegistry *r = registry();
+    r->counts[event].fetchAndAddRelaxed(1);
+    r->latency[event].record(usecs);
+
+    if (isGroupEvent(event)) {
+        GroupShard *shard = localGroupShard();
+        QMutexLocker locker(&shard->guard);
+        shard->counts[from]++;
+    }
+}
+
+/*!
+ * \brief 返回事件 \a event 的累计次数
+ */
+quint32 Metrics::count(Event event)
+{
+    return registry()->counts[event].load();
+}
+
+/*!
+ * \brief 返回事件 \a event 的分发延迟分布
+ */
+Histogram::Snapshot Metrics::latency(Event event)
+{
+    return registry()->latency[event].snapshot();
+}
+
+/*!
+ * \brief 返回各群组的累计事件次数
+ */
+Metrics::GroupCounts Metrics::groupCounts()
+{
+    MetricsRegistry *r = registry();
+
+    QHash<qint64, quint32> counts;
+    QMutexLocker locker(&r->shardsGuard);
+    for (GroupShard *shard : r->shards) {
+        QMutexLocker shardLocker(&shard->guard);
+        for (auto i = shard->counts.constBegin(); i != shard->counts.constEnd(); ++i)
+            counts[i.key()] += i.value();
+    }
+    locker.unlock();
+
+    GroupCounts result;
+    result.reserve(counts.count());
+    for (auto i = counts.constBegin(); i != counts.constEnd(); ++i)
+        result.append(qMakePair(i.key(), i.value()));
+
+    return result;
+}
+
+/*!
+ * \brief 记录一次采样
+ *
+ * 保存当前的事件计数，rates() 以最近两次采样之间的差值计算事件速率。通常由定时器周期调用。
+ */
+void Metrics::sample()
+{
+    MetricsRegistry *r = registry();
+
+    QMutexLocker locker(&r->sampleGuard);
+    r->prevTime = r->lastTime;
+    r->lastTime = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < EventCount; ++i) {
+        r->prevCounts[i] = r->lastCounts[i];
+        r->lastCounts[i] = r->counts[i].load();
+    }
+}
+
+/*!
+ * \brief 返回各类事件每秒的次数
+ *
+ * 距离上次采样超过 5 秒时以上次采样到现在的差值计算，否则使用最近两次采样；还没有采样时返回启动以来的平均值。
+ */
+QVector<double> Metrics::rates()
+{
+    MetricsRegistry *r = registry();
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    QVector<double> rates(EventCount, 0);
+    QMutexLocker locker(&r->sampleGuard);
+    for (int i = 0; i < EventCount; ++i) {
+        quint32 current = r->counts[i].load();
+        if (r->lastTime > 0 && now - r->lastTime >= 5000) {
+            rates[i] = (current - r->lastCounts[i]) * 1000.0 / (now - r->lastTime);
+        } else if (r->prevTime > 0) {
+            rates[i] = (r->lastCounts[i] - r->prevCounts[i]) * 1000.0 / qMax<qint64>(1, r->lastTime - r->prevTime);
+        } else {
+            rates[i] = current * 1000.0 / qMax<qint64>(1, now - r->startTime);
+        }
+    }
+
+    return rates;
+}
+
+/*!
+ * \brief 注册数据源
+ *
+ * 读取 gauges() 时调用 \a source 采集对象 \a owner 的数值。对象析构前必须调用 removeSource()。
+ */
+void Metrics::addSource(const QObject *owner, const Source &source)
+{
+    MetricsRegistry *r = registry();
+
+    QMutexLocker locker(&r->sourcesGuard);
+    r->sources.append(qMakePair(owner, source));
+}
+
+/*!
+ * \brief 移除对象 \a owner 注册的所有数据源
+ */
+void Metrics::removeSource(const QObject *owner)
+{
+    MetricsRegistry *r = registry();
+
+    QMutexLocker locker(&r->sourcesGuard);
+    for (int i = r->sources.count() - 1; i >= 0; --i) {
+        if (r->sources.at(i).first == owner)
+            r->sources.remove(i);
+    }
+}
+
+/*!
+ * \brief 采集所有数据源的数值
+ */
+Metrics::Gauges Metrics::gauges()
+{
+    MetricsRegistry *r = registry();
+
+    Gauges gauges;
+    QMutexLocker locker(&r->sourcesGuard);
+    for (const auto &source : r->sources)
+        source.second(gauges);
+
+    return gauges;
+}
+
+// class EventTimer
+
+/*!
+ * \brief 构造函数
+ *
+ * 开始分发来自 \a from 的事件 \a event，\a actor 为发送者或者相关的成员，一并记入飞行记录。
+ */
+EventTimer::EventTimer(Metrics::Event event, qint64 from, qint64 actor)
+    : event(event)
+    , from(from)
+    , blocked(false)
+{
+    FlightRecorder::record(FlightRecorder::Event, quint16(event), from, actor, 0);
+    timer.start();
+}
+
+/*!
+ * \brief 析构函数
+ */
+EventTimer::~EventTimer()
+{
+    quint32 usecs = quint32(qMin<qint64>(timer.nsecsElapsed() / 1000, 0xffffffffLL));
+    Metrics::record(event, from, usecs);
+    FlightRecorder::record(FlightRecorder::Dispatch, quint16(event), from, blocked ? 1 : 0, usecs);
+}
+
+/*!
+ * \fn bool EventTimer::block()
+ *
+ * 标记事件被某个模块拦截，返回 true。
+ */
+
+} // namespace CoolQ
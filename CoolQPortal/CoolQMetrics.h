@@ -0,0 +1,87 @@
+﻿#ifndef COOLQMETRICS_H
+#define COOLQMETRICS_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QPair>
+#include <QVector>
+
+#include <functional>
+
+#include "CoolQHistogram.h"
+
+class QObject;
+
+namespace CoolQ {
+
+// class Metrics
+
+class Metrics
+{
+public:
+    enum Event {
+        PrivateMessage,
+        GroupMessage,
+        DiscussMessage,
+        MasterChange,
+        FriendRequest,
+        GroupRequest,
+        FriendAdd,
+        MemberJoin,
+        MemberLeave,
+        EventCount
+    };
+
+    struct Gauge
+    {
+        QByteArray name;
+        double value;
+    };
+
+    typedef QVector<Gauge> Gauges;
+    typedef std::function<void(Gauges &)> Source;
+    typedef QVector<QPair<qint64, quint32> > GroupCounts;
+
+public:
+    static void start();
+    static qint64 uptime();
+    static qint64 memoryUsage();
+
+    static const char *name(Event event);
+
+    static void record(Event event, qint64 from, quint32 usecs);
+    static quint32 count(Event event);
+    static Histogram::Snapshot latency(Event event);
+    static GroupCounts groupCounts();
+
+    static void sample();
+    static QVector<double> rates();
+
+    static void addSource(const QObject *owner, const Source &source);
+    static void removeSource(const QObject *owner);
+    static Gauges gauges();
+};
+
+// class EventTimer
+
+class EventTimer
+{
+    Q_DISABLE_COPY(EventTimer)
+
+public:
+    EventTimer(Metrics::Event event, qint64 from, qint64 actor);
+    ~EventTimer();
+
+public:
+    bool block() { blocked = true; return true; }
+
+private:
+    Metrics::Event event;
+    qint64 from;
+    bool blocked;
+    QElapsedTimer timer;
+};
+
+} // namespace CoolQ
+
+#endif // COOLQMETRICS_H
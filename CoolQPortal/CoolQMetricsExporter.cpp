@@ -0,0 +1,326 @@
+﻿/*!
+ * \class CoolQ::MetricsExporter
+ * \brief 统计导出类
+ *
+ * 在后台线程中定期把 Metrics、HandlerMetrics 和 ApiMetrics 的统计写入 Prometheus 文本格式的文件，
+ * 供 node_exporter 的 textfile 收集器读取。文件先写入临时文件再替换，读取方不会看到写了一半的内容。
+ */
+
+#include "CoolQMetricsExporter.h"
+#include "CoolQMetricsExporter_p.h"
+
+#include "CoolQApiMetrics.h"
+#include "CoolQHandlerMetrics.h"
+#include "CoolQMetrics.h"
+
+#include <QSaveFile>
+
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(qlcMetricsExporter, "CoolQ::MetricsExporter")
+
+namespace CoolQ {
+
+namespace {
+
+// 指标名称的前缀。
+const char prefix[] = "qtassistant_";
+
+QByteArray number(double value)
+{
+    return QByteArray::number(value, 'g', 10);
+}
+
+QByteArray seconds(quint32 usecs)
+{
+    return QByteArray::number(usecs / 1e6, 'g', 6);
+}
+
+QByteArray escaped(QByteArray value)
+{
+    return value.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+}
+
+void header(QByteArray &out, const char *name, const char *type, const char *help)
+{
+    out += "# HELP ";
+    out += prefix;
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += prefix;
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void sample(QByteArray &out, const char *name, const QByteArray &labels, const QByteArray &value)
+{
+    out += prefix;
+    out += name;
+    if (!labels.isEmpty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+    out += value;
+    out += '\n';
+}
+
+// 以 summary 的形式输出延迟分布：p50、p90、p99 以及次数和总和（按桶中点估算）。
+void summary(QByteArray &out, const char *name, const QByteArray &labels, const Histogram::Snapshot &s)
+{
+    const QByteArray sep = labels.isEmpty() ? QByteArray() : labels + ',';
+    static const double quantiles[] = { 0.5, 0.9, 0.99 };
+    for (double q : quantiles) {
+        sample(out, name, sep + "quantile=\"" + QByteArray::number(q) + '"', seconds(s.percentile(q)));
+    }
+
+    QByteArray sumName = QByteArray(name) + "_sum";
+    QByteArray countName = QByteArray(name) + "_count";
+    sample(out, sumName.constData(), labels, number(double(s.mean()) * s.count / 1e6));
+    sample(out, countName.constData(), labels, QByteArray::number(s.count));
+}
+
+} // namespace
+
+// class MetricsExporter
+
+/*!
+ * \brief 构造函数
+ *
+ * 定期写入文件 \a fileName，导出线程随之启动。
+ */
+MetricsExporter::MetricsExporter(const QString &fileName, QObject *parent)
+    : Interface(*new MetricsExporterPrivate(), parent)
+{
+    Q_D(MetricsExporter);
+    d->fileName = fileName;
+    d->thread = new MetricsExporterThread(d);
+    d->thread->start(QThread::LowPriority);
+}
+
+/*!
+ * \brief 析构函数
+ *
+ * 停止导出线程。
+ */
+MetricsExporter::~MetricsExporter()
+{
+    Q_D(MetricsExporter);
+
+    do {
+        QMutexLocker locker(&d->guard);
+        d->stopping = true;
+        d->wakeup.wakeAll();
+    } while (false);
+
+    d->thread->wait();
+    delete d->thread;
+}
+
+/*!
+ * \brief 返回导出的文件名
+ */
+QString MetricsExporter::fileName() const
+{
+    Q_D(const MetricsExporter);
+    return d->fileName;
+}
+
+/*!
+ * \brief 返回导出间隔
+ */
+int MetricsExporter::interval() const
+{
+    Q_D(const MetricsExporter);
+
+    QMutexLocker locker(&d->guard);
+    return d->interval;
+}
+
+/*!
+ * \brief 设置导出间隔
+ *
+ * 每隔 \a seconds 秒写入一次文件，小于等于 0 时停止导出。
+ */
+void MetricsExporter::setInterval(int seconds)
+{
+    Q_D(MetricsExporter);
+
+    QMutexLocker locker(&d->guard);
+    d->interval = qMax(0, seconds);
+    d->wakeup.wakeAll();
+}
+
+/*!
+ * \brief 返回成功写入的次数
+ */
+int MetricsExporter::exports() const
+{
+    Q_D(const MetricsExporter);
+
+    QMutexLocker locker(&d->guard);
+    return d->exports;
+}
+
+/*!
+ * \brief 返回 Prometheus 文本格式的统计
+ *
+ * 包括各类事件和各群组的事件数、事件分发和事件处理的延迟、CoolQ 接口的延迟和错误码，以及各数据源注册的数值。
+ * 数据源中以 _total 结尾的数值按 counter 输出，其余按 gauge 输出。
+ */
+QByteArray MetricsExporter::format()
+{
+    QByteArray out;
+    out.reserve(16 * 1024);
+
+    header(out, "uptime_seconds", "gauge", "Time since the plugin was loaded.");
+    sample(out, "uptime_seconds", QByteArray(), number(Metrics::uptime() / 1000.0));
+
+    qint64 memory = Metrics::memoryUsage();
+    if (memory >= 0) {
+        header(out, "memory_bytes", "gauge", "Private memory of the CoolQ process.");
+        sample(out, "memory_bytes", QByteArray(), QByteArray::number(memory));
+    }
+
+    header(out, "events_total", "counter", "Events dispatched by type.");
+    for (int i = 0; i < Metrics::EventCount; ++i) {
+        Metrics::Event event = Metrics::Event(i);
+        sample(out, "events_total", QByteArray("type=\"") + Metrics::name(event) + '"',
+               QByteArray::number(Metrics::count(event)));
+    }
+
+    header(out, "group_events_total", "counter", "Group events dispatched by group.");
+    for (const auto &group : Metrics::groupCounts()) {
+        sample(out, "group_events_total", "group=\"" + QByteArray::number(group.first) + '"',
+               QByteArray::number(group.second));
+    }
+
+    header(out, "dispatch_latency_seconds", "summary", "Time spent dispatching an event to all modules.");
+    for (int i = 0; i < Metrics::EventCount; ++i) {
+        Metrics::Event event = Metrics::Event(i);
+        auto s = Metrics::latency(event);
+        if (s.count > 0)
+            summary(out, "dispatch_latency_seconds", QByteArray("type=\"") + Metrics::name(event) + '"', s);
+    }
+
+    auto handlers = HandlerMetrics::entries();
+    header(out, "handler_latency_seconds", "summary", "Time spent in a module or message filter.");
+    for (const auto &e : handlers)
+        summary(out, "handler_latency_seconds", "handler=\"" + escaped(e.name) + '"', e.latency);
+
+    header(out, "handler_slow_total", "counter", "Handler calls over the time budget.");
+    for (const auto &e : handlers)
+        sample(out, "handler_slow_total", "handler=\"" + escaped(e.name) + '"', QByteArray::number(e.slow));
+
+    header(out, "api_latency_seconds", "summary", "Latency of CoolQ API calls.");
+    for (int i = 0; i < ApiMetrics::ApiCount; ++i) {
+        ApiMetrics::Api api = ApiMetrics::Api(i);
+        auto s = ApiMetrics::latency(api);
+        if (s.count > 0)
+            summary(out, "api_latency_seconds", QByteArray("api=\"") + ApiMetrics::name(api) + '"', s);
+    }
+
+    header(out, "api_errors_total", "counter", "CoolQ API calls by error code.");
+    for (int i = 0; i < ApiMetrics::ApiCount; ++i) {
+        ApiMetrics::Api api = ApiMetrics::Api(i);
+        for (const auto &e : ApiMetrics::errors(api)) {
+            sample(out, "api_errors_total",
+                   QByteArray("api=\"") + ApiMetrics::name(api) + "\",code=\"" + QByteArray::number(e.first) + '"',
+                   QByteArray::number(e.second));
+        }
+    }
+
+    for (const auto &gauge : Metrics::gauges()) {
+        const char *name = gauge.name.constData();
+        bool counter = gauge.name.endsWith("_total");
+        header(out, name, counter ? "counter" : "gauge", counter ? "Counter published by a subsystem." : "Value published by a subsystem.");
+        sample(out, name, QByteArray(), number(gauge.value));
+    }
+
+    return out;
+}
+
+// class MetricsExporterThread
+
+/*!
+ * \internal
+ */
+void MetricsExporterThread::run()
+{
+    d->run();
+}
+
+// class MetricsExporterPrivate
+
+/*!
+ * \internal
+ */
+MetricsExporterPrivate::MetricsExporterPrivate()
+    : thread(nullptr)
+    , stopping(false)
+    , interval(15)
+    , exports(0)
+{
+}
+
+/*!
+ * \internal
+ */
+MetricsExporterPrivate::~MetricsExporterPrivate()
+{
+}
+
+/*!
+ * \internal
+ *
+ * 导出线程的主循环，间隔为 0 时一直等待，直到重新设置间隔或者停止。
+ */
+void MetricsExporterPrivate::run()
+{
+    QMutexLocker locker(&guard);
+
+    while (!stopping) {
+        if (interval > 0)
+            wakeup.wait(&guard, static_cast<unsigned long>(interval) * 1000);
+        else
+            wakeup.wait(&guard);
+        if (stopping || interval <= 0)
+            continue;
+
+        locker.unlock();
+        bool written = write();
+        locker.relock();
+
+        if (written)
+            ++exports;
+    }
+}
+
+/*!
+ * \internal
+ *
+ * 写入一次文件。
+ */
+bool MetricsExporterPrivate::write()
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(qlcMetricsExporter) << "Cannot open" << fileName << file.errorString();
+        return false;
+    }
+
+    file.write(MetricsExporter::format());
+    if (!file.commit()) {
+        qCWarning(qlcMetricsExporter) << "Cannot write" << fileName << file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace CoolQ
@@ -0,0 +1,33 @@
+﻿#ifndef COOLQMETRICSEXPORTER_H
+#define COOLQMETRICSEXPORTER_H
+
+#include "CoolQInterface.h"
+
+namespace CoolQ {
+
+class MetricsExporterPrivate;
+class MetricsExporter : public Interface
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(MetricsExporter)
+
+public:
+    explicit MetricsExporter(const QString &fileName, QObject *parent);
+public:
+    virtual ~MetricsExporter();
+
+public:
+    QString fileName() const;
+
+    int interval() const;
+    void setInterval(int seconds);
+
+    int exports() const;
+
+public:
+    static QByteArray format();
+};
+
+} // namespace CoolQ
+
+#endif // COOLQMETRICSEXPORTER_H
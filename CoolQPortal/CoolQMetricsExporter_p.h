@@ -0,0 +1,52 @@
+﻿#ifndef CQMETRICSEXPORTER_P_H
+#define CQMETRICSEXPORTER_P_H
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "CoolQInterface_p.h"
+#include "CoolQMetricsExporter.h"
+
+namespace CoolQ {
+
+class MetricsExporterPrivate;
+class MetricsExporterThread : public QThread
+{
+public:
+    explicit MetricsExporterThread(MetricsExporterPrivate *d) : d(d) {}
+
+protected:
+    virtual void run() override;
+
+private:
+    MetricsExporterPrivate *d;
+};
+
+class MetricsExporterPrivate : public InterfacePrivate
+{
+    Q_DECLARE_PUBLIC(MetricsExporter)
+
+public:
+    MetricsExporterPrivate();
+    virtual ~MetricsExporterPrivate();
+
+public:
+    void run();
+    bool write();
+
+public:
+    QString fileName;
+    MetricsExporterThread *thread;
+
+    mutable QMutex guard;
+    QWaitCondition wakeup;
+    bool stopping;
+
+    int interval;
+    int exports;
+};
+
+} // namespace CoolQ
+
+#endif // CQMETRICSEXPORTER_P_H
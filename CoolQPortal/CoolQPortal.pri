@@ -4,14 +4,25 @@ DEFINES += TARGET=\\\"$$TARGET\\\"
 
 HEADERS += $$PWD/CoolQApi/CoolQLib.h
 LIBS    += -l$$PWD/CoolQApi/CoolQLib
+win32: LIBS += -lpsapi
 
 HEADERS += \
+    $$PWD/CoolQApiMetrics.h \
+    $$PWD/CoolQFlightRecorder.h \
+    $$PWD/CoolQHandlerMetrics.h \
+    $$PWD/CoolQHistogram.h \
+    $$PWD/CoolQImageCollector.h \
+    $$PWD/CoolQImageCollector_p.h \
     $$PWD/CoolQInterface.h \
     $$PWD/CoolQInterface_p.h \
+    $$PWD/CoolQLogWriter_p.h \
     $$PWD/CoolQMemberInfo.h \
     $$PWD/CoolQMemberInfo_p.h \
     $$PWD/CoolQMessageFilter.h \
     $$PWD/CoolQMessageFilter_p.h \
+    $$PWD/CoolQMetrics.h \
+    $$PWD/CoolQMetricsExporter.h \
+    $$PWD/CoolQMetricsExporter_p.h \
     $$PWD/CoolQPersonInfo.h \
     $$PWD/CoolQPersonInfo_p.h \
     $$PWD/CoolQServiceEngine.h \
@@ -19,15 +30,25 @@ HEADERS += \
     $$PWD/CoolQServiceModule.h \
     $$PWD/CoolQServiceModule_p.h \
     $$PWD/CoolQSqliteService.h \
-    $$PWD/CoolQSqliteService_p.h
+    $$PWD/CoolQSqliteService_p.h \
+    $$PWD/CoolQTracer.h
 
 SOURCES += \
+    $$PWD/CoolQApiMetrics.cpp \
+    $$PWD/CoolQFlightRecorder.cpp \
+    $$PWD/CoolQHandlerMetrics.cpp \
+    $$PWD/CoolQHistogram.cpp \
+    $$PWD/CoolQImageCollector.cpp \
     $$PWD/CoolQInterface.cpp \
+    $$PWD/CoolQLogWriter_p.cpp \
     $$PWD/CoolQMemberInfo.cpp \
     $$PWD/CoolQMessageFilter.cpp \
+    $$PWD/CoolQMetrics.cpp \
+    $$PWD/CoolQMetricsExporter.cpp \
     $$PWD/CoolQPersonInfo.cpp \
     $$PWD/CoolQServiceEngine.cpp \
     $$PWD/CoolQServiceEngine_p.cpp \
     $$PWD/CoolQServiceModule.cpp \
     $$PWD/CoolQServiceModule_p.cpp \
-    $$PWD/CoolQSqliteService.cpp
+    $$PWD/CoolQSqliteService.cpp \
+    $$PWD/CoolQTracer.cpp
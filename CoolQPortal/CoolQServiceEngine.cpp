@@ -8,6 +8,8 @@
 
 #include "CoolQServiceModule.h"
 #include "CoolQServiceModule_p.h"
+#include "CoolQMetrics.h"
+#include "CoolQTracer.h"
 
 namespace CoolQ {
 
@@ -23,6 +25,8 @@ ServiceEngine::ServiceEngine(QObject *parent)
 {
     Q_ASSERT(nullptr == ServiceEnginePrivate::instance);
     ServiceEnginePrivate::instance = this;
+
+    Metrics::start();
 }
 
 /*!
@@ -90,10 +94,14 @@ bool ServiceEngine::initialize()
 bool ServiceEngine::privateMessageEvent(const MessageEvent &ev)
 {
     Q_D(ServiceEngine);
+    CQ_TRACE("ServiceEngine::privateMessageEvent");
+    EventTimer eventTimer(Metrics::PrivateMessage, ev.from, ev.sender);
 
-    for (ServiceModule *module : d->privateMessageModules)
+    for (ServiceModule *module : d->privateMessageModules) {
+        HandlerTimer timer(ServiceEnginePrivate::handler(module), "private", ev.from);
         if (module->privateMessageEvent(ev))
-            return true;
+            return eventTimer.block();
+    }
 
     return false;
 }
@@ -107,10 +115,14 @@ bool ServiceEngine::privateMessageEvent(const MessageEvent &ev)
 bool ServiceEngine::groupMessageEvent(const MessageEvent &ev)
 {
     Q_D(ServiceEngine);
+    CQ_TRACE("ServiceEngine::groupMessageEvent");
+    EventTimer eventTimer(Metrics::GroupMessage, ev.from, ev.sender);
 
-    for (ServiceModule *module : d->groupMessageModules)
+    for (ServiceModule *module : d->groupMessageModules) {
+        HandlerTimer timer(ServiceEnginePrivate::handler(module), "group", ev.from);
         if (module->groupMessageEvent(ev))
-            return true;
+            return eventTimer.block();
+    }
 
     return false;
 }
@@ -124,10 +136,14 @@ bool ServiceEngine::groupMessageEvent(const MessageEvent &ev)
 bool ServiceEngine::discussMessageEvent(const MessageEvent &ev)
 {
     Q_D(ServiceEngine);
+    CQ_TRACE("ServiceEngine::discussMessageEvent");
+    EventTimer eventTimer(Metrics::DiscussMessage, ev.from, ev.sender);
 
-    for (ServiceModule *module : d->discussMessageModules)
+    for (ServiceModule *module : d->discussMessageModules) {
+        HandlerTimer timer(ServiceEnginePrivate::handler(module), "discuss", ev.from);
         if (module->discussMessageEvent(ev))
-            return true;
+            return eventTimer.block();
+    }
 
     return false;
 }
@@ -141,10 +157,14 @@ bool ServiceEngine::discussMessageEvent(const MessageEvent &ev)
 bool ServiceEngine::masterChangeEvent(const MasterChangeEvent &ev)
 {
     Q_D(ServiceEngine);
+    CQ_TRACE("ServiceEngine::masterChangeEvent");
+    EventTimer eventTimer(Metrics::MasterChange, ev.from, ev.member);
 
-    for (ServiceModule *module : d->masterChangeModules)
+    for (ServiceModule *module : d->masterChangeModules) {
+        HandlerTimer timer(ServiceEnginePrivate::handler(module), "masterChange", ev.from);
         if (module->masterChangeEvent(ev))
-            return true;
+            return eventTimer.block();
+    }
 
     return false;
 }
@@ -158,10 +178,14 @@ bool ServiceEngine::masterChangeEvent(const MasterChangeEvent &ev)
 bool ServiceEngine::friendRequestEvent(const FriendRequestEvent &ev)
 {
     Q_D(ServiceEngine);
+    CQ_TRACE("ServiceEngine::friendRequestEvent");
+    EventTimer eventTimer(Metrics::FriendRequest, ev.from, 0);
 
-    for (ServiceModule *module : d->friendRequestModules)
+    for (ServiceModule *module : d->friendRequestModules) {
+        HandlerTimer timer(ServiceEnginePrivate::handler(module), "friendRequest", ev.from);
         if (module->friendRequestEvent(ev))
-            return true;
+            return eventTimer.block();
+    }
 
     return false;
 }
@@ -175,10 +199,14 @@ bool ServiceEngine::friendRequestEvent(const FriendRequestEvent &ev)
 bool ServiceEngine::groupRequestEvent(const GroupRequestEvent &ev)
 {
     Q_D(ServiceEngine);
+    CQ_TRACE("ServiceEngine::groupRequestEvent");
+    EventTimer eventTimer(Metrics::GroupRequest, ev.from, ev.user);
 
-    for (ServiceModule *module : d->groupRequestModules)
+    for (ServiceModule *module : d->groupRequestModules) {
+        HandlerTimer timer(ServiceEnginePrivate::handler(module), "groupRequest", ev.from);
         if (module->groupRequestEvent(ev))
-            return true;
+            return eventTimer.block();
+    }
 
     return false;
 }
@@ -192,10 +220,14 @@ bool ServiceEngine::groupRequestEvent(const GroupRequestEvent &ev)
 bool ServiceEngine::friendAddEvent(const FriendAddEvent &ev)
 {
     Q_D(ServiceEngine);
+    CQ_TRACE("ServiceEngine::friendAddEvent");
+    EventTimer eventTimer(Metrics::FriendAdd, ev.from, 0);
 
-    for (ServiceModule *module : d->friendAddModules)
+    for (ServiceModule *module : d->friendAddModules) {
+        HandlerTimer timer(ServiceEnginePrivate::handler(module), "friendAdd", ev.from);
         if (module->friendAddEvent(ev))
-            return true;
+            return eventTimer.block();
+    }
 
     return false;
 }
@@ -209,10 +241,14 @@ bool ServiceEngine::friendAddEvent(const FriendAddEvent &ev)
 bool ServiceEngine::memberJoinEvent(const MemberJoinEvent &ev)
 {
     Q_D(ServiceEngine);
+    CQ_TRACE("ServiceEngine::memberJoinEvent");
+    EventTimer eventTimer(Metrics::MemberJoin, ev.from, ev.member);
 
-    for (ServiceModule *module : d->memberJoinModules)
+    for (ServiceModule *module : d->memberJoinModules) {
+        HandlerTimer timer(ServiceEnginePrivate::handler(module), "memberJoin", ev.from);
         if (module->memberJoinEvent(ev))
-            return true;
+            return eventTimer.block();
+    }
 
     return false;
 }
@@ -226,10 +262,14 @@ bool ServiceEngine::memberJoinEvent(const MemberJoinEvent &ev)
 bool ServiceEngine::memberLeaveEvent(const MemberLeaveEvent &ev)
 {
     Q_D(ServiceEngine);
+    CQ_TRACE("ServiceEngine::memberLeaveEvent");
+    EventTimer eventTimer(Metrics::MemberLeave, ev.from, ev.member);
 
-    for (ServiceModule *module : d->memberLeaveModules)
+    for (ServiceModule *module : d->memberLeaveModules) {
+        HandlerTimer timer(ServiceEnginePrivate::handler(module), "memberLeave", ev.from);
         if (module->memberLeaveEvent(ev))
-            return true;
+            return eventTimer.block();
+    }
 
     return false;
 }
@@ -264,4 +304,14 @@ void ServiceEnginePrivate::installModule(ServiceModule *module)
     modules.append(module);
 }
 
+/*!
+ * \internal
+ *
+ * 返回模块 \a module 的处理统计。
+ */
+HandlerMetrics::Handler *ServiceEnginePrivate::handler(ServiceModule *module)
+{
+    return HandlerMetrics::handler(ServiceModulePrivate::get(module)->handlerMetrics, module);
+}
+
 } // namespace CoolQ
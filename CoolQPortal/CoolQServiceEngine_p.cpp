@@ -3,10 +3,14 @@
 
 #include <process.h>
 #include <QCoreApplication>
+#include <QThreadStorage>
 
 #include "CoolQApi/CoolQLib.h"
 #include "CoolQServiceModule.h"
 #include "CoolQServiceModule_p.h"
+#include "CoolQFlightRecorder.h"
+#include "CoolQLogWriter_p.h"
+#include "CoolQTracer.h"
 
 CQEVENT(const char *, AppInfo, 0)()
 {
@@ -39,18 +43,31 @@ void cqMsgHandler(QtMsgType type, const QMessageLogContext &ctx, const QString &
         break;
     }
 
-    static char log[4096] = {0};
+    // 每个线程在自己的缓冲区中格式化，写入 CoolQ 由日志线程完成。
+    static QThreadStorage<QByteArray> buffers;
+    QByteArray &log = buffers.localData();
+
     QByteArray gbkMsg = CoolQ::trGbk(msg);
-    sprintf(log, "%s (%s: %u)", gbkMsg.constData(), ctx.file, ctx.line);
-    CQ_addLog(CoolQ::ServiceEnginePrivate::accessToken, priority, "Qt Logs", log);
-    if (CQLOG_FATAL == priority)
-        CQ_setFatal(CoolQ::ServiceEnginePrivate::accessToken, gbkMsg.constData());
+    log = gbkMsg;
+    log += " (";
+    log += ctx.file ? ctx.file : "";
+    log += ": ";
+    log += QByteArray::number(ctx.line);
+    log += ')';
+
+    if (CQLOG_FATAL == priority) {
+        CoolQ::FlightRecorder::dump("fatal");
+        CoolQ::LogWriter::instance()->fatal(log, gbkMsg);
+    } else {
+        CoolQ::LogWriter::instance()->post(priority, log);
+    }
 }
 
 CQEVENT(qint32, Initialize, 4)(qint32 ac)
 {
-    qInstallMessageHandler(cqMsgHandler);
     CoolQ::ServiceEnginePrivate::accessToken = ac;
+    CoolQ::LogWriter::instance()->start();
+    qInstallMessageHandler(cqMsgHandler);
 
     return 0;
 }
@@ -77,6 +94,11 @@ CQEVENT(qint32, __systemShutdownEvent, 0)()
     if (qApp)
         qApp->quit();
 
+    CoolQ::FlightRecorder::dump("shutdown");
+
+    // 写完队列中的日志，之后的日志同步写入。
+    CoolQ::LogWriter::instance()->stop();
+
     return 0;
 }
 
@@ -92,6 +114,8 @@ CQEVENT(qint32, __pluginDisableEvent, 0)()
 
 CQEVENT(qint32, __privateMessageEvent, 24)(qint32 type, qint32 time, qint64 from, const char *msg, qint32 font)
 {
+    CQ_TRACE("__privateMessageEvent");
+
     if (auto engine = CoolQ::ServiceEngine::instance()) {
         CoolQ::MessageEvent event{ type, time, 0, font, from, msg };
         if (engine->privateMessageEvent(event))
@@ -103,6 +127,8 @@ CQEVENT(qint32, __privateMessageEvent, 24)(qint32 type, qint32 time, qint64 from
 
 CQEVENT(qint32, __groupMessageEvent, 36)(qint32 type, qint32 time, qint64 from, qint64 sender, const char *, const char *msg, qint32 font)
 {
+    CQ_TRACE("__groupMessageEvent");
+
     if (auto engine = CoolQ::ServiceEngine::instance()) {
         CoolQ::MessageEvent event{ type, time, from, font, sender, msg };
         if (engine->groupMessageEvent(event))
@@ -114,6 +140,8 @@ CQEVENT(qint32, __groupMessageEvent, 36)(qint32 type, qint32 time, qint64 from,
 
 CQEVENT(qint32, __discussMessageEvent, 32)(qint32 type, qint32 time, qint64 from, qint64 sender, const char *msg, qint32 font)
 {
+    CQ_TRACE("__discussMessageEvent");
+
     if (auto engine = CoolQ::ServiceEngine::instance()) {
         CoolQ::MessageEvent event{ type, time, from, font, sender, msg };
         if (engine->discussMessageEvent(event))
@@ -125,6 +153,8 @@ CQEVENT(qint32, __discussMessageEvent, 32)(qint32 type, qint32 time, qint64 from
 
 CQEVENT(qint32, __masterChangeEvent, 24)(qint32 type, qint32 time, qint64 from, qint64 member)
 {
+    CQ_TRACE("__masterChangeEvent");
+
     if (auto engine = CoolQ::ServiceEngine::instance()) {
         CoolQ::MasterChangeEvent event{ type, time, from, 0, member };
         if (engine->masterChangeEvent(event))
@@ -136,6 +166,8 @@ CQEVENT(qint32, __masterChangeEvent, 24)(qint32 type, qint32 time, qint64 from,
 
 CQEVENT(qint32, __friendRequestEvent, 24)(qint32 type, qint32 time, qint64 from, const char *msg, const char *tag)
 {
+    CQ_TRACE("__friendRequestEvent");
+
     if (auto engine = CoolQ::ServiceEngine::instance()) {
         CoolQ::FriendRequestEvent event{ type, time, from, msg, tag };
         if (engine->friendRequestEvent(event))
@@ -147,6 +179,8 @@ CQEVENT(qint32, __friendRequestEvent, 24)(qint32 type, qint32 time, qint64 from,
 
 CQEVENT(qint32, __groupRequestEvent, 32)(qint32 type, qint32 time, qint64 from, qint64 user, const char *msg, const char *tag)
 {
+    CQ_TRACE("__groupRequestEvent");
+
     if (auto engine = CoolQ::ServiceEngine::instance()) {
         CoolQ::GroupRequestEvent event{ type, time, from, user, msg, tag };
         if (engine->groupRequestEvent(event))
@@ -158,6 +192,8 @@ CQEVENT(qint32, __groupRequestEvent, 32)(qint32 type, qint32 time, qint64 from,
 
 CQEVENT(qint32, __friendAddEvent, 16)(qint32 type, qint32 time, qint64 from)
 {
+    CQ_TRACE("__friendAddEvent");
+
     if (auto engine = CoolQ::ServiceEngine::instance()) {
         CoolQ::FriendAddEvent event{ type, time, from };
         if (engine->friendAddEvent(event))
@@ -169,6 +205,8 @@ CQEVENT(qint32, __friendAddEvent, 16)(qint32 type, qint32 time, qint64 from)
 
 CQEVENT(qint32, __memberJoinEvent, 32)(qint32 type, qint32 time, qint64 from, qint64 master, qint64 member)
 {
+    CQ_TRACE("__memberJoinEvent");
+
     if (auto engine = CoolQ::ServiceEngine::instance()) {
         CoolQ::MemberJoinEvent event{ type, time, from, master, member };
         if (engine->memberJoinEvent(event))
@@ -180,6 +218,8 @@ CQEVENT(qint32, __memberJoinEvent, 32)(qint32 type, qint32 time, qint64 from, qi
 
 CQEVENT(qint32, __memberLeaveEvent, 32)(qint32 type, qint32 time, qint64 from, qint64 master, qint64 member)
 {
+    CQ_TRACE("__memberLeaveEvent");
+
     if (auto engine = CoolQ::ServiceEngine::instance()) {
         CoolQ::MemberLeaveEvent event{ type, time, from, master, member };
         if (engine->memberLeaveEvent(event))
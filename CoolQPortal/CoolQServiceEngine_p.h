@@ -1,6 +1,7 @@
 ﻿#ifndef COOLQSERVICEENGINE_P_H
 #define COOLQSERVICEENGINE_P_H
 
+#include "CoolQHandlerMetrics.h"
 #include "CoolQInterface_p.h"
 #include "CoolQServiceEngine.h"
 
@@ -20,6 +21,7 @@ public:
 
 public:
     void installModule(ServiceModule *module);
+    static HandlerMetrics::Handler *handler(ServiceModule *module);
 public:
     QList<ServiceModule *> modules;
     static qint32 accessToken;
@@ -29,12 +29,26 @@
 
 #include "CoolQServiceEngine.h"
 #include "CoolQServiceEngine_p.h"
-
+#include "CoolQMessageFilter_p.h"
+#include "CoolQImageCollector.h"
+#include "CoolQApiMetrics.h"
+#include "CoolQFlightRecorder.h"
+#include "CoolQMetrics.h"
+#include "CoolQTracer.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
 #include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageWriter>
+#include <QPainter>
 #include <QPixmap>
+#include <QSaveFile>
 #include <QStringBuilder>
 #include <QtDebug>
-#include <QUuid>
 
 #include "CoolQApi/CoolQLib.h"
 #include "CoolQSqliteService_p.h"
@@ -63,6 +77,8 @@ ServiceModule::ServiceModule(ServiceModulePrivate &dd, ServiceEngine *parent)
     d->resPath = QDir::cleanPath(path % "/../../data");
     d->basePath = QDir::cleanPath(path);
     d->imagePath = QDir::cleanPath(path % "/../../data/image");
+    d->loadImageIndex();
+    d->imageCollector = new ImageCollector(d->imagePath, this);
 
     QString sqlitePath = d->basePath % '/' % QString::number(d->currentId);
     SqliteServicePrivate::basePath = QDir::cleanPath(sqlitePath);
@@ -89,6 +105,8 @@ ServiceModule::ServiceModule(ServiceEngine *parent)
     d->resPath = QDir::cleanPath(path % "/../../data");
     d->basePath = QDir::cleanPath(path);
     d->imagePath = QDir::cleanPath(path % "/../../data/image");
+    d->loadImageIndex();
+    d->imageCollector = new ImageCollector(d->imagePath, this);
 
     QString sqlitePath = d->basePath % '/' % QString::number(d->currentId);
     SqliteServicePrivate::basePath = QDir::cleanPath(sqlitePath);
@@ -102,6 +120,7 @@ ServiceModule::ServiceModule(ServiceEngine *parent)
  */
 ServiceModule::~ServiceModule()
 {
+    Metrics::removeSource(this);
 }
 
 /*!
@@ -162,6 +181,23 @@ bool ServiceModule::initialize()
         }
     }
 
+    // 致命错误和关闭时，飞行记录写入插件的用户目录。
+    FlightRecorder::setDirectory(usrFilePath("Flights"));
+
+    // 图片编码和回收的统计在读取时才采集。
+    Metrics::addSource(this, [this](Metrics::Gauges &gauges) {
+        ImageMetrics im = imageMetrics();
+        ImageCollector::Metrics cm = imageCollector()->metrics();
+        gauges.append({ "image_encoded_total", double(im.count) });
+        gauges.append({ "image_encoded_bytes_total", double(im.bytes) });
+        gauges.append({ "image_encode_msecs_total", double(im.msecs) });
+        gauges.append({ "image_reused_total", double(im.reused) });
+        gauges.append({ "image_dir_files", double(cm.files) });
+        gauges.append({ "image_dir_bytes", double(cm.bytes) });
+        gauges.append({ "image_removed_files_total", double(cm.removedFiles) });
+        gauges.append({ "image_removed_bytes_total", double(cm.removedBytes) });
+    });
+
     return true;
 }
 
@@ -412,9 +448,12 @@ int ServiceModule::memberLeaveEventPriority() const
 bool ServiceModule::privateMessageEvent(const MessageEvent &ev)
 {
     Q_D(ServiceModule);
+    CQ_TRACE("ServiceModule::privateMessageEvent");
 
     if (!d->privateFilters.isEmpty()) {
         for (auto filter : d->privateFilters) {
+            CQ_TRACE(filter->metaObject()->className());
+            HandlerTimer timer(ServiceModulePrivate::handler(filter), "private", ev.from);
             if (filter->privateMessageFilter(0, ev)) {
                 return true;
             }
@@ -423,8 +462,11 @@ bool ServiceModule::privateMessageEvent(const MessageEvent &ev)
 
     for (int i = 0; i < 33; ++i) {
         if ((ev.gbkMsg[i] == 0) || (ev.gbkMsg[i] == ' ')) {
-            if (auto filter = d->privateKeywordFilters.value(QByteArray(ev.gbkMsg, i)))
+            if (auto filter = d->privateKeywordFilters.value(QByteArray(ev.gbkMsg, i))) {
+                CQ_TRACE(filter->metaObject()->className());
+                HandlerTimer timer(ServiceModulePrivate::handler(filter), "private", ev.from, ev.gbkMsg, i);
                 return filter->privateMessageFilter(i, ev);
+            }
         }
     }
 
@@ -440,9 +482,12 @@ bool ServiceModule::privateMessageEvent(const MessageEvent &ev)
 bool ServiceModule::groupMessageEvent(const MessageEvent &ev)
 {
     Q_D(ServiceModule);
+    CQ_TRACE("ServiceModule::groupMessageEvent");
 
     if (!d->groupFilters.isEmpty()) {
         for (auto filter : d->groupFilters) {
+            CQ_TRACE(filter->metaObject()->className());
+            HandlerTimer timer(ServiceModulePrivate::handler(filter), "group", ev.from);
             if (filter->groupMessageFilter(0, ev)) {
                 return true;
             }
@@ -451,8 +496,11 @@ bool ServiceModule::groupMessageEvent(const MessageEvent &ev)
 
     for (int i = 0; i < 33; ++i) {
         if ((ev.gbkMsg[i] == 0) || (ev.gbkMsg[i] == ' ')) {
-            if (auto filter = d->groupKeywordFilters.value(QByteArray(ev.gbkMsg, i)))
+            if (auto filter = d->groupKeywordFilters.value(QByteArray(ev.gbkMsg, i))) {
+                CQ_TRACE(filter->metaObject()->className());
+                HandlerTimer timer(ServiceModulePrivate::handler(filter), "group", ev.from, ev.gbkMsg, i);
                 return filter->groupMessageFilter(i, ev);
+            }
         }
     }
 
@@ -468,9 +516,12 @@ bool ServiceModule::groupMessageEvent(const MessageEvent &ev)
 bool ServiceModule::discussMessageEvent(const MessageEvent &ev)
 {
     Q_D(ServiceModule);
+    CQ_TRACE("ServiceModule::discussMessageEvent");
 
     if (!d->discussFilters.isEmpty()) {
         for (auto filter : d->discussFilters) {
+            CQ_TRACE(filter->metaObject()->className());
+            HandlerTimer timer(ServiceModulePrivate::handler(filter), "discuss", ev.from);
             if (filter->discussMessageFilter(0, ev)) {
                 return true;
             }
@@ -479,8 +530,11 @@ bool ServiceModule::discussMessageEvent(const MessageEvent &ev)
 
     for (int i = 0; i < 33; ++i) {
         if ((ev.gbkMsg[i] == 0) || (ev.gbkMsg[i] == ' ')) {
-            if (auto filter = d->discussKeywordFilters.value(QByteArray(ev.gbkMsg, i)))
+            if (auto filter = d->discussKeywordFilters.value(QByteArray(ev.gbkMsg, i))) {
+                CQ_TRACE(filter->metaObject()->className());
+                HandlerTimer timer(ServiceModulePrivate::handler(filter), "discuss", ev.from, ev.gbkMsg, i);
                 return filter->discussMessageFilter(i, ev);
+            }
         }
     }
 
@@ -568,7 +622,9 @@ bool ServiceModule::memberLeaveEvent(const MemberLeaveEvent &ev)
  */
 ServiceModule::Result ServiceModule::sendPrivateMessage(qint64 uid, const char *gbkMsg) const
 {
-    return ServiceModulePrivate::result(CQ_sendPrivateMsg(ServiceEnginePrivate::accessToken, uid, gbkMsg));
+    CQ_TRACE("CQ_sendPrivateMsg");
+    ApiTimer timer(ApiMetrics::SendPrivateMsg);
+    return ServiceModulePrivate::result(timer(CQ_sendPrivateMsg(ServiceEnginePrivate::accessToken, uid, gbkMsg)));
 }
 
 /*!
@@ -580,7 +636,9 @@ ServiceModule::Result ServiceModule::sendPrivateMessage(qint64 uid, const char *
  */
 ServiceModule::Result ServiceModule::sendGroupMessage(qint64 gid, const char *gbkMsg) const
 {
-    return ServiceModulePrivate::result(CQ_sendGroupMsg(ServiceEnginePrivate::accessToken, gid, gbkMsg));
+    CQ_TRACE("CQ_sendGroupMsg");
+    ApiTimer timer(ApiMetrics::SendGroupMsg);
+    return ServiceModulePrivate::result(timer(CQ_sendGroupMsg(ServiceEnginePrivate::accessToken, gid, gbkMsg)));
 }
 
 /*!
@@ -592,7 +650,9 @@ ServiceModule::Result ServiceModule::sendGroupMessage(qint64 gid, const char *gb
  */
 ServiceModule::Result ServiceModule::sendDiscussMessage(qint64 did, const char *gbkMsg) const
 {
-    return ServiceModulePrivate::result(CQ_sendDiscussMsg(ServiceEnginePrivate::accessToken, did, gbkMsg));
+    CQ_TRACE("CQ_sendDiscussMsg");
+    ApiTimer timer(ApiMetrics::SendDiscussMsg);
+    return ServiceModulePrivate::result(timer(CQ_sendDiscussMsg(ServiceEnginePrivate::accessToken, did, gbkMsg)));
 }
 
 /*!
@@ -636,7 +696,8 @@ ServiceModule::Result ServiceModule::sendDiscussMessage(qint64 did, const QStrin
  */
 ServiceModule::Result ServiceModule::banGroupMember(qint64 gid, qint64 uid, int duration)
 {
-    return ServiceModulePrivate::result(CQ_setGroupBan(ServiceEnginePrivate::accessToken, gid, uid, duration));
+    ApiTimer timer(ApiMetrics::SetGroupBan);
+    return ServiceModulePrivate::result(timer(CQ_setGroupBan(ServiceEnginePrivate::accessToken, gid, uid, duration)));
 }
 
 /*!
@@ -647,7 +708,8 @@ ServiceModule::Result ServiceModule::banGroupMember(qint64 gid, qint64 uid, int
  */
 ServiceModule::Result ServiceModule::kickGroupMember(qint64 gid, qint64 uid, bool lasting)
 {
-    return ServiceModulePrivate::result(CQ_setGroupKick(ServiceEnginePrivate::accessToken, gid, uid, lasting));
+    ApiTimer timer(ApiMetrics::SetGroupKick);
+    return ServiceModulePrivate::result(timer(CQ_setGroupKick(ServiceEnginePrivate::accessToken, gid, uid, lasting)));
 }
 
 /*!
@@ -658,7 +720,8 @@ ServiceModule::Result ServiceModule::kickGroupMember(qint64 gid, qint64 uid, boo
  */
 ServiceModule::Result ServiceModule::adminGroupMember(qint64 gid, qint64 uid, bool enabled)
 {
-    return ServiceModulePrivate::result(CQ_setGroupAdmin(ServiceEnginePrivate::accessToken, gid, uid, enabled));
+    ApiTimer timer(ApiMetrics::SetGroupAdmin);
+    return ServiceModulePrivate::result(timer(CQ_setGroupAdmin(ServiceEnginePrivate::accessToken, gid, uid, enabled)));
 }
 
 /*!
@@ -670,7 +733,8 @@ ServiceModule::Result ServiceModule::adminGroupMember(qint64 gid, qint64 uid, bo
  */
 ServiceModule::Result ServiceModule::renameGroupMember(qint64 gid, qint64 uid, const char *gbkNewNameCard)
 {
-    return ServiceModulePrivate::result(CQ_setGroupCard(ServiceEnginePrivate::accessToken, gid, uid, gbkNewNameCard));
+    ApiTimer timer(ApiMetrics::SetGroupCard);
+    return ServiceModulePrivate::result(timer(CQ_setGroupCard(ServiceEnginePrivate::accessToken, gid, uid, gbkNewNameCard)));
 }
 
 /*!
@@ -681,7 +745,8 @@ ServiceModule::Result ServiceModule::renameGroupMember(qint64 gid, qint64 uid, c
  */
 ServiceModule::Result ServiceModule::renameGroupMember(qint64 gid, qint64 uid, const QString &newNameCard)
 {
-    return ServiceModulePrivate::result(CQ_setGroupCard(ServiceEnginePrivate::accessToken, gid, uid, trGbk(newNameCard).constData()));
+    ApiTimer timer(ApiMetrics::SetGroupCard);
+    return ServiceModulePrivate::result(timer(CQ_setGroupCard(ServiceEnginePrivate::accessToken, gid, uid, trGbk(newNameCard).constData())));
 }
 
 /*!
@@ -692,7 +757,8 @@ ServiceModule::Result ServiceModule::renameGroupMember(qint64 gid, qint64 uid, c
  */
 ServiceModule::Result ServiceModule::acceptRequest(const char *gbkTag)
 {
-    return ServiceModulePrivate::result(CQ_setFriendAddRequest(ServiceEnginePrivate::accessToken, gbkTag, REQUEST_ALLOW, ""));
+    ApiTimer timer(ApiMetrics::SetFriendAddRequest);
+    return ServiceModulePrivate::result(timer(CQ_setFriendAddRequest(ServiceEnginePrivate::accessToken, gbkTag, REQUEST_ALLOW, "")));
 }
 
 /*!
@@ -703,7 +769,8 @@ ServiceModule::Result ServiceModule::acceptRequest(const char *gbkTag)
  */
 ServiceModule::Result ServiceModule::rejectRequest(const char *gbkTag)
 {
-    return ServiceModulePrivate::result(CQ_setFriendAddRequest(ServiceEnginePrivate::accessToken, gbkTag, REQUEST_DENY, ""));
+    ApiTimer timer(ApiMetrics::SetFriendAddRequest);
+    return ServiceModulePrivate::result(timer(CQ_setFriendAddRequest(ServiceEnginePrivate::accessToken, gbkTag, REQUEST_DENY, "")));
 }
 
 /*!
@@ -715,9 +782,11 @@ ServiceModule::Result ServiceModule::rejectRequest(const char *gbkTag)
 ServiceModule::Result ServiceModule::acceptRequest(qint32 type, const char *gbkTag)
 {
     if (1 == type) {
-        return ServiceModulePrivate::result(CQ_setGroupAddRequestV2(ServiceEnginePrivate::accessToken, gbkTag, REQUEST_GROUPADD, REQUEST_ALLOW, ""));
+        ApiTimer timer(ApiMetrics::SetGroupAddRequest);
+        return ServiceModulePrivate::result(timer(CQ_setGroupAddRequestV2(ServiceEnginePrivate::accessToken, gbkTag, REQUEST_GROUPADD, REQUEST_ALLOW, "")));
     } else if (2 == type) {
-        return ServiceModulePrivate::result(CQ_setGroupAddRequestV2(ServiceEnginePrivate::accessToken, gbkTag, REQUEST_GROUPINVITE, REQUEST_ALLOW, ""));
+        ApiTimer timer(ApiMetrics::SetGroupAddRequest);
+        return ServiceModulePrivate::result(timer(CQ_setGroupAddRequestV2(ServiceEnginePrivate::accessToken, gbkTag, REQUEST_GROUPINVITE, REQUEST_ALLOW, "")));
     }
 
     return Result::Unknown;
@@ -732,9 +801,11 @@ ServiceModule::Result ServiceModule::acceptRequest(qint32 type, const char *gbkT
 ServiceModule::Result ServiceModule::rejectRequest(qint32 type, const char *gbkTag)
 {
     if (1 == type) {
-        return ServiceModulePrivate::result(CQ_setGroupAddRequestV2(ServiceEnginePrivate::accessToken, gbkTag, REQUEST_GROUPADD, REQUEST_DENY, ""));
+        ApiTimer timer(ApiMetrics::SetGroupAddRequest);
+        return ServiceModulePrivate::result(timer(CQ_setGroupAddRequestV2(ServiceEnginePrivate::accessToken, gbkTag, REQUEST_GROUPADD, REQUEST_DENY, "")));
     } else if (2 == type) {
-        return ServiceModulePrivate::result(CQ_setGroupAddRequestV2(ServiceEnginePrivate::accessToken, gbkTag, REQUEST_GROUPINVITE, REQUEST_DENY, ""));
+        ApiTimer timer(ApiMetrics::SetGroupAddRequest);
+        return ServiceModulePrivate::result(timer(CQ_setGroupAddRequestV2(ServiceEnginePrivate::accessToken, gbkTag, REQUEST_GROUPINVITE, REQUEST_DENY, "")));
     }
 
     return Result::Unknown;
@@ -748,7 +819,8 @@ ServiceModule::Result ServiceModule::rejectRequest(qint32 type, const char *gbkT
  */
 ServiceModule::Result ServiceModule::leaveGroup(qint64 gid)
 {
-    return ServiceModulePrivate::result(CQ_setGroupLeave(ServiceEnginePrivate::accessToken, gid, false));
+    ApiTimer timer(ApiMetrics::SetGroupLeave);
+    return ServiceModulePrivate::result(timer(CQ_setGroupLeave(ServiceEnginePrivate::accessToken, gid, false)));
 }
 
 /*!
@@ -759,7 +831,8 @@ ServiceModule::Result ServiceModule::leaveGroup(qint64 gid)
  */
 ServiceModule::Result ServiceModule::leaveDiscuss(qint64 did)
 {
-    return ServiceModulePrivate::result(CQ_setDiscussLeave(ServiceEnginePrivate::accessToken, did));
+    ApiTimer timer(ApiMetrics::SetDiscussLeave);
+    return ServiceModulePrivate::result(timer(CQ_setDiscussLeave(ServiceEnginePrivate::accessToken, did)));
 }
 
 /*!
@@ -770,7 +843,8 @@ ServiceModule::Result ServiceModule::leaveDiscuss(qint64 did)
  */
 ServiceModule::Result ServiceModule::mute(qint64 gid, bool muted)
 {
-    return ServiceModulePrivate::result(CQ_setGroupWholeBan(ServiceEnginePrivate::accessToken, gid, muted));
+    ApiTimer timer(ApiMetrics::SetGroupWholeBan);
+    return ServiceModulePrivate::result(timer(CQ_setGroupWholeBan(ServiceEnginePrivate::accessToken, gid, muted)));
 }
 
 /*!
@@ -781,7 +855,8 @@ ServiceModule::Result ServiceModule::mute(qint64 gid, bool muted)
  */
 PersonInfo ServiceModule::personInfo(qint64 uid, bool cached)
 {
-    return PersonInfo(CQ_getStrangerInfo(ServiceEnginePrivate::accessToken, uid, !cached));
+    ApiTimer timer(ApiMetrics::GetStrangerInfo);
+    return PersonInfo(timer(CQ_getStrangerInfo(ServiceEnginePrivate::accessToken, uid, !cached)));
 }
 
 /*!
@@ -792,25 +867,113 @@ PersonInfo ServiceModule::personInfo(qint64 uid, bool cached)
  */
 MemberInfo ServiceModule::memberInfo(qint64 gid, qint64 uid, bool cached)
 {
-    return MemberInfo(CQ_getGroupMemberInfoV2(ServiceEnginePrivate::accessToken, gid, uid, !cached));
+    ApiTimer timer(ApiMetrics::GetGroupMemberInfo);
+    return MemberInfo(timer(CQ_getGroupMemberInfoV2(ServiceEnginePrivate::accessToken, gid, uid, !cached)));
 }
 
 /*!
  * \brief 保存图片
  *
  * 将图片 \a data 保存到 CoolQ 待发送图片目录。如果成功，返回自动生成的文件名。
+ * \sa ServiceModule::setImageFormat
  */
 QString ServiceModule::saveImage(const QPixmap &data) const
+{
+    return saveImage(data.toImage());
+}
+
+/*!
+ * \brief 保存图片
+ *
+ * 将图片 \a data 按当前的编码策略保存到 CoolQ 待发送图片目录。与 QPixmap 不同，QImage 可以在任意线程中使用。如果成功，返回自动生成的文件名。
+ *
+ * 文件名由编码后内容的哈希值生成，相同内容的图片只写入一次。
+ * \sa ServiceModule::setImageFormat ServiceModule::imageMetrics
+ */
+QString ServiceModule::saveImage(const QImage &data) const
 {
     Q_D(const ServiceModule);
+    CQ_TRACE("ServiceModule::saveImage");
+
+    if (data.isNull())
+        return QString();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    ImageFormat format = static_cast<ImageFormat>(d->imageFormat.load());
+    int quality = d->imageQuality.load();
+    QByteArray bytes;
+
+    if (format == AutoFormat) {
+        format = PngFormat;
+        bytes = ServiceModulePrivate::encodeImage(data, PngFormat, -1);
+
+        // 大尺寸卡片同时尝试 WebP，保留较小的结果。
+        if (data.width() * data.height() >= 400 * 800 && ServiceModulePrivate::isWebpSupported()) {
+            QByteArray webpBytes = ServiceModulePrivate::encodeImage(data, WebpFormat, quality);
+            if (!webpBytes.isEmpty() && webpBytes.size() < bytes.size()) {
+                format = WebpFormat;
+                bytes = webpBytes;
+            }
+        }
+    } else {
+        if (format == WebpFormat && !ServiceModulePrivate::isWebpSupported())
+            format = PngFormat;
+        bytes = ServiceModulePrivate::encodeImage(data, format, quality);
+    }
+
+    if (bytes.isEmpty())
+        return QString();
+
+    const char *suffix = ".png";
+    if (format == JpegFormat) {
+        suffix = ".jpg";
+    } else if (format == WebpFormat) {
+        suffix = ".webp";
+    }
+
+    QString fileName = ServiceModulePrivate::imageName(bytes, suffix);
+    QString filePath = d->imagePath % '/' % fileName;
+
+    // 先标记为使用中再检查文件，回收器不会在检查之后删除它。
+    d->imageCollector->touch(fileName);
+
+    bool exists = false;
+    do {
+        QMutexLocker locker(&d->imageIndexGuard);
+        exists = d->imageIndex.contains(fileName);
+    } while (false);
+
+    // 索引中的文件可能已经被外部删除，命中时再确认一次。
+    if (exists && !QFileInfo::exists(filePath))
+        exists = false;
+
+    if (!exists) {
+        QSaveFile file(filePath);
+        if (!file.open(QIODevice::WriteOnly))
+            return QString();
+
+        file.write(bytes);
+        if (!file.commit())
+            return QString();
+
+        QMutexLocker locker(&d->imageIndexGuard);
+        d->imageIndex.insert(fileName);
+    }
+
+    qint64 msecs = timer.elapsed();
 
-    QString uuid = QString::fromLatin1(QUuid::createUuid().toRfc4122().toHex());
-    QString name = QString("%1/%2.png").arg(d->imagePath, uuid);
-    if (data.save(name, "PNG", 0)) {
-        return uuid % ".png";
+    QMutexLocker locker(&d->imageMetricsGuard);
+    if (exists) {
+        d->imageMetrics.reused++;
+    } else {
+        d->imageMetrics.count++;
+        d->imageMetrics.bytes += bytes.size();
     }
+    d->imageMetrics.msecs += msecs;
 
-    return QString();
+    return fileName;
 }
 
 /*!
@@ -824,6 +987,81 @@ QPixmap ServiceModule::loadImage(const QString &name) const
     return QPixmap();
 }
 
+/*!
+ * \brief 返回图片编码格式
+ *
+ * 默认为 ServiceModule::AutoFormat，即使用快速压缩的 PNG，较大的卡片在 WebP 更小时改用 WebP。
+ * \sa ServiceModule::setImageFormat
+ */
+ServiceModule::ImageFormat ServiceModule::imageFormat() const
+{
+    Q_D(const ServiceModule);
+
+    return static_cast<ImageFormat>(d->imageFormat.load());
+}
+
+/*!
+ * \brief 设置图片编码格式
+ *
+ * 设置 ServiceModule::saveImage 使用的编码格式为 \a format。如果没有安装 WebP 插件，WebP 格式会回退为 PNG。
+ */
+void ServiceModule::setImageFormat(ImageFormat format)
+{
+    Q_D(ServiceModule);
+
+    d->imageFormat.store(format);
+}
+
+/*!
+ * \brief 返回图片编码质量
+ *
+ * 返回 -1 表示使用各格式的默认质量。
+ * \sa ServiceModule::setImageQuality
+ */
+int ServiceModule::imageQuality() const
+{
+    Q_D(const ServiceModule);
+
+    return d->imageQuality.load();
+}
+
+/*!
+ * \brief 设置图片编码质量
+ *
+ * 设置编码质量为 \a quality，取值范围 0 到 100。对于 PNG，质量越高压缩级别越低，编码越快。在 ServiceModule::AutoFormat 下，此质量只作用于 WebP，PNG 总是使用快速压缩。
+ */
+void ServiceModule::setImageQuality(int quality)
+{
+    Q_D(ServiceModule);
+
+    d->imageQuality.store(qBound(-1, quality, 100));
+}
+
+/*!
+ * \brief 返回图片编码统计
+ *
+ * 返回已保存的图片数量、写入的字节数、编码和写入所用的总毫秒数，以及因内容相同而跳过写入的次数。
+ */
+ServiceModule::ImageMetrics ServiceModule::imageMetrics() const
+{
+    Q_D(const ServiceModule);
+
+    QMutexLocker locker(&d->imageMetricsGuard);
+    return d->imageMetrics;
+}
+
+/*!
+ * \brief 返回图片回收器
+ *
+ * 回收器在后台限制待发送图片目录的大小。保存的图片会自动标记为已引用，复用已有图片时需要调用 ImageCollector::touch 。
+ * \sa ImageCollector
+ */
+ImageCollector *ServiceModule::imageCollector() const
+{
+    Q_D(const ServiceModule);
+    return d->imageCollector;
+}
+
 // class ServiceModulePrivate
 
 /*!
@@ -844,7 +1082,15 @@ ServiceModulePrivate::ServiceModulePrivate()
     , friendAddEventPriority(1)
     , memberJoinEventPriority(1)
     , memberLeaveEventPriority(1)
+    //
+    , imageFormat(ServiceModule::AutoFormat)
+    , imageQuality(-1)
+    , imageCollector(nullptr)
 {
+    imageMetrics.count = 0;
+    imageMetrics.bytes = 0;
+    imageMetrics.msecs = 0;
+    imageMetrics.reused = 0;
 }
 
 /*!
@@ -864,6 +1110,67 @@ void ServiceModulePrivate::installFilter(MessageFilter *filter)
     filters.append(filter);
 }
 
+/*!
+ * \internal
+ *
+ * 将图片 \a data 按 \a format 编码到内存中，\a quality 为 -1 时使用该格式的默认质量。
+ */
+QByteArray ServiceModulePrivate::encodeImage(const QImage &data, ServiceModule::ImageFormat format, int quality)
+{
+    if (quality < 0)
+        quality = defaultImageQuality(format);
+
+    QImage image = data;
+    const char *formatName = "PNG";
+    if (format == ServiceModule::JpegFormat) {
+        // JPEG 不支持透明，先合成到白色底上。
+        image = QImage(data.size(), QImage::Format_RGB32);
+        image.fill(Qt::white);
+        QPainter painter(&image);
+        painter.drawImage(0, 0, data);
+        painter.end();
+        formatName = "JPEG";
+    } else if (format == ServiceModule::WebpFormat) {
+        formatName = "WEBP";
+    }
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::WriteOnly);
+
+    QImageWriter writer(&buffer, formatName);
+    writer.setQuality(quality);
+    if (!writer.write(image))
+        return QByteArray();
+
+    return bytes;
+}
+
+/*!
+ * \internal
+ *
+ * PNG 的质量会被换算为压缩级别，80 对应 zlib 的 1 级压缩，速度远快于 0 对应的 9 级。
+ */
+int ServiceModulePrivate::defaultImageQuality(ServiceModule::ImageFormat format)
+{
+    switch (format) {
+    case ServiceModule::JpegFormat:
+    case ServiceModule::WebpFormat:
+        return 90;
+    default:
+        return 80;
+    }
+}
+
+/*!
+ * \internal
+ */
+bool ServiceModulePrivate::isWebpSupported()
+{
+    static const bool supported = QImageWriter::supportedImageFormats().contains("webp");
+    return supported;
+}
+
 /*!
  * \internal
  */
@@ -881,4 +1188,46 @@ ServiceModule::Result ServiceModulePrivate::result(qint32 r)
     return ServiceModule::Unknown;
 }
 
+/*!
+ * \internal
+ *
+ * 返回过滤器 \a filter 的处理统计。
+ */
+HandlerMetrics::Handler *ServiceModulePrivate::handler(MessageFilter *filter)
+{
+    return HandlerMetrics::handler(MessageFilterPrivate::get(filter)->handlerMetrics, filter);
+}
+
+/*!
+ * \internal
+ *
+ * 返回内容为 \a bytes 的图片文件名，由 MD5 的十六进制形式和后缀 \a suffix 组成。
+ */
+QString ServiceModulePrivate::imageName(const QByteArray &bytes, const char *suffix)
+{
+    QByteArray hash = QCryptographicHash::hash(bytes, QCryptographicHash::Md5);
+    return QString::fromLatin1(hash.toHex()) % QLatin1String(suffix);
+}
+
+/*!
+ * \internal
+ *
+ * 扫描图片目录，记录已有的按内容命名的图片文件。
+ */
+void ServiceModulePrivate::loadImageIndex()
+{
+    QSet<QString> fileNames;
+
+    QDirIterator it(imagePath, QStringList() << "*.png" << "*.jpg" << "*.webp", QDir::Files);
+    while (it.hasNext()) {
+        it.next();
+        QString fileName = it.fileName();
+        if (fileName.indexOf('.') == 32)
+            fileNames.insert(fileName);
+    }
+
+    QMutexLocker locker(&imageIndexGuard);
+    imageIndex = fileNames;
+}
+
 } // namespace CoolQ
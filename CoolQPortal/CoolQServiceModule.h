@@ -9,6 +9,7 @@
 namespace CoolQ {
 
 class ServiceEngine;
+class ImageCollector;
 class ServiceModulePrivate;
 class ServiceModule : public Interface
 {
@@ -117,7 +118,35 @@ public:
 
 public:
     QString saveImage(const QPixmap &data) const;
+    QString saveImage(const QImage &data) const;
     QPixmap loadImage(const QString &name) const;
+
+public:
+    enum ImageFormat {
+        PngFormat,
+        JpegFormat,
+        WebpFormat,
+        AutoFormat
+    };
+    Q_ENUM(ImageFormat)
+
+    struct ImageMetrics {
+        int count;
+        qint64 bytes;
+        qint64 msecs;
+        int reused;
+    };
+
+public:
+    ImageFormat imageFormat() const;
+    void setImageFormat(ImageFormat format);
+
+    int imageQuality() const;
+    void setImageQuality(int quality);
+
+    ImageMetrics imageMetrics() const;
+
+    ImageCollector *imageCollector() const;
 };
 
 } // namespace CoolQ
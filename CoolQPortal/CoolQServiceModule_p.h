@@ -1,6 +1,10 @@
 ﻿#ifndef CQSERVICEMODULE_P_H
 #define CQSERVICEMODULE_P_H
 
+#include <QMutex>
+#include <QSet>
+
+#include "CoolQHandlerMetrics.h"
 #include "CoolQInterface_p.h"
 #include "CoolQServiceModule.h"
 #include "CoolQMessageFilter.h"
@@ -39,6 +43,10 @@ protected:
 public:
     static ServiceModule::Result result(qint32 r);
 
+public:
+    static HandlerMetrics::Handler *handler(MessageFilter *filter);
+    QAtomicPointer<HandlerMetrics::Handler> handlerMetrics;
+
 protected:
     int privateMessageEventPriority;
     int groupMessageEventPriority;
@@ -59,6 +67,27 @@ protected:
     QString resPath;
     QString basePath;
     QString imagePath;
+
+public:
+    static QByteArray encodeImage(const QImage &data, ServiceModule::ImageFormat format, int quality);
+    static int defaultImageQuality(ServiceModule::ImageFormat format);
+    static bool isWebpSupported();
+
+    static QString imageName(const QByteArray &bytes, const char *suffix);
+    void loadImageIndex();
+
+protected:
+    // 设置可能来自其他线程，编码时各读取一次。
+    QAtomicInt imageFormat;
+    QAtomicInt imageQuality;
+
+    mutable QMutex imageMetricsGuard;
+    mutable ServiceModule::ImageMetrics imageMetrics;
+
+    mutable QMutex imageIndexGuard;
+    mutable QSet<QString> imageIndex;
+
+    ImageCollector *imageCollector;
 };
 
 } // namespace CoolQ
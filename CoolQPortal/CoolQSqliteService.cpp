@@ -161,6 +161,56 @@ QSqlQuery SqliteService::query(const char *srcSql)
     return QSqlQuery(QString::fromUtf8(srcSql), d->dbs);
 }
 
+/*!
+ * \brief 预编译 Sql 语句
+ *
+ * 此方法将创建一个 QSqlQuery 并预编译 UTF-8 编码的 \a srcSql 语句，但并不执行。绑定参数后可以反复执行。
+ */
+QSqlQuery SqliteService::prepareQuery(const char *srcSql)
+{
+    Q_D(SqliteService);
+
+    QSqlQuery query(d->dbs);
+    query.prepare(QString::fromUtf8(srcSql));
+    return query;
+}
+
+/*!
+ * \brief 开始事务
+ *
+ * 批量写入应在同一个事务中完成，以减少文件同步的次数。如果成功返回 true；否则返回 false。
+ */
+bool SqliteService::transaction()
+{
+    Q_D(SqliteService);
+
+    return d->dbs.transaction();
+}
+
+/*!
+ * \brief 提交事务
+ *
+ * 如果成功返回 true；否则返回 false。
+ */
+bool SqliteService::commit()
+{
+    Q_D(SqliteService);
+
+    return d->dbs.commit();
+}
+
+/*!
+ * \brief 回滚事务
+ *
+ * 如果成功返回 true；否则返回 false。
+ */
+bool SqliteService::rollback()
+{
+    Q_D(SqliteService);
+
+    return d->dbs.rollback();
+}
+
 // class SqliteServicePrivate
 
 QString SqliteServicePrivate::basePath;
@@ -31,6 +31,12 @@ protected:
 protected:
     QSqlQuery query(const QString &sql);
     QSqlQuery query(const char *srcSql);
+    QSqlQuery prepareQuery(const char *srcSql);
+
+protected:
+    bool transaction();
+    bool commit();
+    bool rollback();
 };
 
 } // namespace CoolQ
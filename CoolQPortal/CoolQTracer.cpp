@@ -0,0 +1,262 @@
+﻿/*!
+ * \class CoolQ::Tracer
+ * \brief 事件追踪
+ *
+ * 开启后，CQ_TRACE 标记的作用域在进入和离开时各记录一个事件，写入当前线程自己的环形缓冲区。
+ * 缓冲区的总大小按进程限定，线程退出后缓冲区留给新的线程复用；缓冲区用完时，新线程的事件不被记录。
+ * 导出的文件是 Chrome 追踪格式（chrome://tracing）的 JSON。关闭时每个作用域只多一次原子读取。
+ * 事件名称必须是静态字符串，这里只保存指针。
+ */
+
+#include "CoolQTracer.h"
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QSaveFile>
+#include <QThreadStorage>
+#include <QVector>
+
+namespace CoolQ {
+
+namespace {
+
+// 整个进程保留的事件数，分成固定数量的线程缓冲区。
+const int processCapacity = 64 * 1024;
+const int maxBuffers = 16;
+const int bufferCapacity = processCapacity / maxBuffers;
+
+struct TraceEvent
+{
+    const char *name;
+    qint64 ts;
+    char phase;
+};
+
+struct TraceBuffer
+{
+    int tid;
+    QMutex guard;
+    QVector<TraceEvent> events;
+    int next = 0;
+    bool wrapped = false;
+};
+
+struct TraceRegistry
+{
+    QMutex guard;
+    QList<TraceBuffer *> buffers;
+    QList<TraceBuffer *> released;
+    int nextTid = 0;
+
+    // 还能分给新线程的缓冲区数，用完时记录事件不必再加锁查看。
+    QAtomicInt available{maxBuffers};
+};
+
+TraceRegistry &registry()
+{
+    static TraceRegistry r;
+    return r;
+}
+
+struct LocalBuffer
+{
+    TraceBuffer *buffer = nullptr;
+
+    // 线程退出时交还缓冲区，其中的事件在被复用之前仍然可以导出。
+    ~LocalBuffer()
+    {
+        if (buffer) {
+            QMutexLocker locker(&registry().guard);
+            registry().released.append(buffer);
+            registry().available.ref();
+        }
+    }
+};
+
+struct TraceClock
+{
+    TraceClock() { timer.start(); }
+    QElapsedTimer timer;
+};
+
+qint64 currentTime()
+{
+    static TraceClock clock;
+    return clock.timer.nsecsElapsed() / 1000;
+}
+
+TraceBuffer *localBuffer()
+{
+    // 先构造 registry，保证它比线程存储晚析构。
+    TraceRegistry &r = registry();
+    static QThreadStorage<LocalBuffer> local;
+
+    LocalBuffer &l = local.localData();
+    if (!l.buffer) {
+        if (r.available.load() <= 0)
+            return nullptr;
+
+        QMutexLocker locker(&r.guard);
+        if (!r.released.isEmpty()) {
+            l.buffer = r.released.takeFirst();
+
+            QMutexLocker bufferLocker(&l.buffer->guard);
+            l.buffer->next = 0;
+            l.buffer->wrapped = false;
+        } else if (r.buffers.count() < maxBuffers) {
+            l.buffer = new TraceBuffer();
+            l.buffer->events.resize(bufferCapacity);
+            r.buffers.append(l.buffer);
+        } else {
+            return nullptr;
+        }
+        l.buffer->tid = ++r.nextTid;
+        r.available.deref();
+    }
+
+    return l.buffer;
+}
+
+void record(const char *name, char phase)
+{
+    qint64 ts = currentTime();
+    TraceBuffer *buffer = localBuffer();
+    if (!buffer)
+        return;
+
+    // 只有导出时才会竞争这把锁。
+    QMutexLocker locker(&buffer->guard);
+    TraceEvent &event = buffer->events[buffer->next];
+    event.name = name;
+    event.ts = ts;
+    event.phase = phase;
+    if (++buffer->next == bufferCapacity) {
+        buffer->next = 0;
+        buffer->wrapped = true;
+    }
+}
+
+void appendJsonString(QByteArray &out, const char *s)
+{
+    out += '"';
+    for (; *s; ++s) {
+        char ch = *s;
+        if (ch == '"' || ch == '\\') {
+            out += '\\';
+            out += ch;
+        } else if (uchar(ch) < 0x20) {
+            out += ' ';
+        } else {
+            out += ch;
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+QAtomicInt Tracer::enabled(0);
+
+/*!
+ * \brief 开启或关闭追踪
+ */
+void Tracer::setEnabled(bool on)
+{
+    currentTime();
+    enabled.store(on ? 1 : 0);
+}
+
+/*!
+ * \brief 记录作用域 \a name 的开始
+ */
+void Tracer::begin(const char *name)
+{
+    record(name, 'B');
+}
+
+/*!
+ * \brief 记录作用域 \a name 的结束
+ */
+void Tracer::end(const char *name)
+{
+    record(name, 'E');
+}
+
+/*!
+ * \brief 导出追踪文件
+ *
+ * 将所有线程缓冲区中的事件写入 \a fileName，返回写入的事件数；失败时返回 -1。
+ */
+int Tracer::dump(const QString &fileName)
+{
+    // 导出期间持有 registry 的锁，缓冲区不会被新线程复用。
+    TraceRegistry &r = registry();
+    QMutexLocker registryLocker(&r.guard);
+    QList<TraceBuffer *> list = r.buffers;
+
+    QByteArray out;
+    out.reserve(1024 * 1024);
+    out += "{\"traceEvents\":[";
+
+    int count = 0;
+    for (TraceBuffer *buffer : list) {
+        QVector<TraceEvent> events;
+        do {
+            QMutexLocker locker(&buffer->guard);
+            if (buffer->wrapped) {
+                events = buffer->events.mid(buffer->next) + buffer->events.mid(0, buffer->next);
+            } else {
+                events = buffer->events.mid(0, buffer->next);
+            }
+        } while (false);
+
+        // 环形缓冲区覆盖掉的开始事件无法配对，跳过开头没有开始事件的结束事件。
+        int depth = 0;
+        for (const auto &event : events) {
+            if (event.phase == 'E' && depth == 0)
+                continue;
+            depth += (event.phase == 'B') ? 1 : -1;
+
+            if (count++ > 0)
+                out += ',';
+            out += "{\"name\":";
+            appendJsonString(out, event.name);
+            out += ",\"ph\":\"";
+            out += event.phase;
+            out += "\",\"ts\":";
+            out += QByteArray::number(event.ts);
+            out += ",\"pid\":1,\"tid\":";
+            out += QByteArray::number(buffer->tid);
+            out += '}';
+        }
+    }
+
+    out += "],\"displayTimeUnit\":\"ms\"}";
+    registryLocker.unlock();
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return -1;
+    file.write(out);
+    if (!file.commit())
+        return -1;
+
+    return count;
+}
+
+/*!
+ * \brief 清空所有线程缓冲区中的事件
+ */
+void Tracer::clear()
+{
+    TraceRegistry &r = registry();
+    QMutexLocker locker(&r.guard);
+    for (TraceBuffer *buffer : r.buffers) {
+        QMutexLocker bufferLocker(&buffer->guard);
+        buffer->next = 0;
+        buffer->wrapped = false;
+    }
+}
+
+} // namespace CoolQ
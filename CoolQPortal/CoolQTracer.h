@@ -0,0 +1,50 @@
+﻿#ifndef COOLQTRACER_H
+#define COOLQTRACER_H
+
+#include <QAtomicInt>
+#include <QString>
+
+namespace CoolQ {
+
+// class Tracer
+
+class Tracer
+{
+public:
+    static bool isEnabled() { return enabled.load() != 0; }
+    static void setEnabled(bool on);
+
+    static void begin(const char *name);
+    static void end(const char *name);
+
+    static int dump(const QString &fileName);
+    static void clear();
+
+private:
+    static QAtomicInt enabled;
+};
+
+// class TraceScope
+
+class TraceScope
+{
+    Q_DISABLE_COPY(TraceScope)
+
+public:
+    explicit TraceScope(const char *name)
+        : name(Tracer::isEnabled() ? name : nullptr)
+    { if (this->name) Tracer::begin(this->name); }
+    ~TraceScope()
+    { if (name) Tracer::end(name); }
+
+private:
+    const char *name;
+};
+
+} // namespace CoolQ
+
+#define CQ_TRACE_CONCAT_(a, b) a##b
+#define CQ_TRACE_CONCAT(a, b) CQ_TRACE_CONCAT_(a, b)
+#define CQ_TRACE(name) CoolQ::TraceScope CQ_TRACE_CONCAT(cqTraceScope, __LINE__)(name)
+
+#endif // COOLQTRACER_H
@@ -0,0 +1,226 @@
+﻿#include "AssistantConfig.h"
+
+#include <QJsonArray>
+#include <QMap>
+#include <QScopedPointer>
+
+#include <algorithm>
+
+namespace {
+
+bool readIds(const QJsonObject &o, const char *key, QSet<qint64> *ids, QString *errorString)
+{
+    QJsonValue value = o.value(QLatin1String(key));
+    if (value.isUndefined())
+        return true;
+
+    if (!value.isArray()) {
+        *errorString = QString("%1 is not an array").arg(QLatin1String(key));
+        return false;
+    }
+
+    QJsonArray array = value.toArray();
+    for (int i = 0; i < array.count(); ++i) {
+        // 号码可以写成字符串，也可以写成数字。
+        QJsonValue item = array.at(i);
+        qint64 id = 0;
+        if (item.isDouble()) {
+            id = qint64(item.toDouble());
+        } else if (item.isString()) {
+            id = item.toString().toLongLong();
+        }
+
+        if (id <= 0) {
+            *errorString = QString("%1[%2] is not a QQ number").arg(QLatin1String(key)).arg(i);
+            return false;
+        }
+
+        ids->insert(id);
+    }
+
+    return true;
+}
+
+bool checkType(const QJsonObject &o, const char *const keys[], QJsonValue::Type type, QString *errorString)
+{
+    for (int i = 0; keys[i]; ++i) {
+        QJsonValue value = o.value(QLatin1String(keys[i]));
+        if (!value.isUndefined() && value.type() != type) {
+            *errorString = QString("%1 has a wrong type").arg(QLatin1String(keys[i]));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool readInt(const QJsonObject &o, const char *key, int minimum, int maximum, qint32 *value,
+             const QString &where, QString *errorString)
+{
+    QJsonValue v = o.value(QLatin1String(key));
+    if (v.isUndefined())
+        return true;
+
+    int i = v.toInt(minimum - 1);
+    if (!v.isDouble() || i < minimum || i > maximum) {
+        *errorString = QString("%1.%2 must be between %3 and %4")
+                .arg(where).arg(QLatin1String(key)).arg(minimum).arg(maximum);
+        return false;
+    }
+
+    *value = i;
+    return true;
+}
+
+bool readBool(const QJsonObject &o, const char *key, bool *value, const QString &where, QString *errorString)
+{
+    QJsonValue v = o.value(QLatin1String(key));
+    if (v.isUndefined())
+        return true;
+
+    if (!v.isBool()) {
+        *errorString = QString("%1.%2 is not a boolean").arg(where).arg(QLatin1String(key));
+        return false;
+    }
+
+    *value = v.toBool();
+    return true;
+}
+
+// 在 policy 上覆盖 o 中给出的项，未知的项视为错误，避免拼写错误被悄悄忽略。
+bool readPolicy(const QJsonValue &value, GroupPolicy *policy, const QString &where, QString *errorString)
+{
+    static const char *const keys[] = {
+        "managed", "banHongbao", "hongbaoBanTime", "watchTime", "cardWidth",
+        "orderPermission", "targetPermission", nullptr
+    };
+
+    if (!value.isObject()) {
+        *errorString = QString("%1 is not an object").arg(where);
+        return false;
+    }
+
+    QJsonObject o = value.toObject();
+    for (auto iter = o.constBegin(); iter != o.constEnd(); ++iter) {
+        int i = 0;
+        while (keys[i] && iter.key() != QLatin1String(keys[i]))
+            ++i;
+        if (!keys[i]) {
+            *errorString = QString("%1.%2 is unknown").arg(where).arg(iter.key());
+            return false;
+        }
+    }
+
+    // 禁言时长受接口限制，最长 30 天；权限 1 为成员，2 为管理员，3 为群主。
+    // 目标权限必须低于发令权限，所以发令至少需要管理员。
+    if (!readBool(o, "managed", &policy->managed, where, errorString)
+            || !readBool(o, "banHongbao", &policy->banHongbao, where, errorString)
+            || !readInt(o, "hongbaoBanTime", 60, 30 * 86400, &policy->hongbaoBanTime, where, errorString)
+            || !readInt(o, "watchTime", 60, 7 * 86400, &policy->watchTime, where, errorString)
+            || !readInt(o, "cardWidth", 200, 2000, &policy->cardWidth, where, errorString)
+            || !readInt(o, "orderPermission", 2, 3, &policy->orderPermission, where, errorString)
+            || !readInt(o, "targetPermission", 1, 3, &policy->targetPermission, where, errorString)) {
+        return false;
+    }
+
+    // 管理命令只能处理权限比发令者要求更低的成员，否则管理员之间可以互相禁言或踢出。
+    if (policy->targetPermission >= policy->orderPermission) {
+        *errorString = QString("%1.targetPermission must be lower than orderPermission").arg(where);
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+AssistantConfig::AssistantConfig()
+{
+}
+
+// 解析并检查配置，出错时返回 nullptr，并在 errorString 中给出原因。
+AssistantConfig *AssistantConfig::fromJson(const QJsonObject &o, QString *errorString)
+{
+    static const char *const numbers[] = {
+        "handlerBudget", "renderCacheSize", "renderWorkers", "renderThemes", "renderColors",
+        "imageQuality", "imageCacheSize", "imageCacheFiles", "imageCacheProtect",
+        "metricsInterval", "metricsExport", nullptr
+    };
+    static const char *const booleans[] = { "tracing", "renderDithering", nullptr };
+    static const char *const strings[] = { "imageFormat", nullptr };
+
+    QScopedPointer<AssistantConfig> config(new AssistantConfig());
+
+    QSet<qint64> managedGroups;
+    QSet<qint64> banHongbaoGroups;
+    if (!readIds(o, "superUsers", &config->superUsers, errorString)
+            || !readIds(o, "managedGroups", &managedGroups, errorString)
+            || !readIds(o, "banHongbaoGroups", &banHongbaoGroups, errorString)) {
+        return nullptr;
+    }
+
+    if (o.contains("defaultPolicy")
+            && !readPolicy(o.value("defaultPolicy"), &config->defaultPolicy, "defaultPolicy", errorString)) {
+        return nullptr;
+    }
+
+    // 先按旧的群组列表打开开关，再由每个群的策略对象覆盖。
+    QMap<qint64, GroupPolicy> policies;
+    for (auto gid : managedGroups) {
+        auto iter = policies.insert(gid, policies.value(gid, config->defaultPolicy));
+        iter->managed = true;
+    }
+    for (auto gid : banHongbaoGroups) {
+        auto iter = policies.insert(gid, policies.value(gid, config->defaultPolicy));
+        iter->banHongbao = true;
+    }
+
+    QJsonValue groups = o.value("groupPolicies");
+    if (!groups.isUndefined()) {
+        if (!groups.isObject()) {
+            *errorString = QString("groupPolicies is not an object");
+            return nullptr;
+        }
+
+        QJsonObject go = groups.toObject();
+        for (auto iter = go.constBegin(); iter != go.constEnd(); ++iter) {
+            QString where = QString("groupPolicies.%1").arg(iter.key());
+            qint64 gid = iter.key().toLongLong();
+            if (gid <= 0) {
+                *errorString = QString("%1 is not a group number").arg(where);
+                return nullptr;
+            }
+
+            GroupPolicy policy = policies.value(gid, config->defaultPolicy);
+            if (!readPolicy(iter.value(), &policy, where, errorString))
+                return nullptr;
+            policies.insert(gid, policy);
+        }
+    }
+
+    config->groupIds.reserve(policies.count());
+    config->groupPolicies.reserve(policies.count());
+    for (auto iter = policies.constBegin(); iter != policies.constEnd(); ++iter) {
+        config->groupIds.append(iter.key());
+        config->groupPolicies.append(iter.value());
+    }
+
+    if (!checkType(o, numbers, QJsonValue::Double, errorString)
+            || !checkType(o, booleans, QJsonValue::Bool, errorString)
+            || !checkType(o, strings, QJsonValue::String, errorString)) {
+        return nullptr;
+    }
+
+    config->settings = o;
+    return config.take();
+}
+
+// 返回群的策略，没有单独配置的群返回默认策略。
+const GroupPolicy &AssistantConfig::policy(qint64 gid) const
+{
+    auto iter = std::lower_bound(groupIds.constBegin(), groupIds.constEnd(), gid);
+    if (iter != groupIds.constEnd() && *iter == gid)
+        return groupPolicies.at(int(iter - groupIds.constBegin()));
+
+    return defaultPolicy;
+}
@@ -0,0 +1,48 @@
+﻿#ifndef ASSISTANTCONFIG_H
+#define ASSISTANTCONFIG_H
+
+#include <QJsonObject>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+// 群组策略，加载时按群编译成一条记录，事件处理时只需查找一次。
+struct GroupPolicy
+{
+    bool managed = false;
+    bool banHongbao = false;
+    qint32 hongbaoBanTime = 3600;   // 发送红包的禁言时长，单位为秒。
+    qint32 watchTime = 1800;        // 新成员的观察时长，单位为秒。
+    qint32 cardWidth = 400;         // 卡片宽度，单位为像素。
+    qint32 orderPermission = 2;     // 发出管理命令所需的最低权限。
+    qint32 targetPermission = 1;    // 管理命令可以处理的最高权限。
+};
+Q_DECLARE_TYPEINFO(GroupPolicy, Q_PRIMITIVE_TYPE);
+
+// 不可变的配置快照，加载后只读，可以在任意线程中无锁读取。
+class AssistantConfig
+{
+    Q_DISABLE_COPY(AssistantConfig)
+
+public:
+    AssistantConfig();
+
+public:
+    static AssistantConfig *fromJson(const QJsonObject &o, QString *errorString);
+
+public:
+    const GroupPolicy &policy(qint64 gid) const;
+
+public:
+    QSet<qint64> superUsers;
+
+    // 按群号排序的平坦表，未列出的群使用默认策略。
+    GroupPolicy defaultPolicy;
+    QVector<qint64> groupIds;
+    QVector<GroupPolicy> groupPolicies;
+
+    // 其它设置项，由 AssistantModule 在加载后应用。
+    QJsonObject settings;
+};
+
+#endif // ASSISTANTCONFIG_H
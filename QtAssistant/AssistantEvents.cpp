@@ -1,14 +1,17 @@
 ﻿#include "AssistantModule.h"
 #include "AssistantModule_p.h"
+#include "AssistantConfig.h"
 
 #include <QStringBuilder>
 #include <QTextStream>
 #include <QFileInfo>
-#include <QMetaEnum>
 #include <QPixmap>
 #include <QUuid>
 #include <QDir>
 
+#include "CoolQImageCollector.h"
+
+#include "SqlDatas/MemberAuditlog.h"
 #include "SqlDatas/MemberBlacklist.h"
 #include "SqlDatas/MemberWatchlist.h"
 
@@ -31,14 +34,18 @@ bool AssistantModule::friendRequestEvent(const CoolQ::FriendRequestEvent &ev)
 bool AssistantModule::groupRequestEvent(const CoolQ::GroupRequestEvent &ev)
 {
     Q_D(AssistantModule);
+    AssistantConfigReader reader(d);
 
-    if (!d->managedGroups.contains(ev.from)) {
+    if (!d->snapshot()->policy(ev.from).managed) {
         return false;
     }
 
     // 黑名单检查，如果发现匹配，直接拒绝。
     if (d->blacklist->contains(ev.from, ev.user)) {
-        rejectRequest(ev.type, ev.gbkTag);
+        d->blacklistHits.fetchAndAddRelaxed(1);
+        if (rejectRequest(ev.type, ev.gbkTag) == NoError) {
+            d->auditlog->addRecord(ev.from, ev.user, currentId(), MemberAuditlog::RejectRequest);
+        }
         return false;
     }
 
@@ -54,14 +61,18 @@ bool AssistantModule::friendAddEvent(const CoolQ::FriendAddEvent &ev)
 bool AssistantModule::memberJoinEvent(const CoolQ::MemberJoinEvent &ev)
 {
     Q_D(AssistantModule);
+    AssistantConfigReader reader(d);
 
-    if (!d->managedGroups.contains(ev.from)) {
+    if (!d->snapshot()->policy(ev.from).managed) {
         return false;
     }
 
     // 黑名单检查，如果发现匹配，直接踢出。
     if (d->blacklist->contains(ev.from, ev.member)) {
-        kickGroupMember(ev.from, ev.member, false);
+        d->blacklistHits.fetchAndAddRelaxed(1);
+        if (kickGroupMember(ev.from, ev.member, false) == NoError) {
+            d->auditlog->addRecord(ev.from, ev.member, currentId(), MemberAuditlog::Kick, 0, QString(u8"黑名单"));
+        }
         return false;
     }
 
@@ -70,11 +81,13 @@ bool AssistantModule::memberJoinEvent(const CoolQ::MemberJoinEvent &ev)
 
     // 尝试修改昵称。
     QString nameCard;
+    QString nickName;
+    QString location;
     bool unknownLocation = false;
     CoolQ::MemberInfo mi = memberInfo(ev.from, ev.member, false);
     if (mi.isValid()) {
-        QString nickName = mi.nickName().trimmed();
-        QString location = mi.location().trimmed();
+        nickName = mi.nickName().trimmed();
+        location = mi.location().trimmed();
         d->safetyNameCard(nickName);
 
         if (!nickName.isEmpty()) {
@@ -83,36 +96,44 @@ bool AssistantModule::memberJoinEvent(const CoolQ::MemberJoinEvent &ev)
                 location = QString(u8"所在地");
             }
             nameCard = '[' % location % ']' % nickName;
-            renameGroupMember(ev.from, ev.member, nameCard);
+            if (renameGroupMember(ev.from, ev.member, nameCard) == NoError) {
+                d->auditlog->addRecord(ev.from, ev.member, currentId(), MemberAuditlog::Rename, 0, nameCard);
+            }
         }
     }
 
-    QString msg;
-    QTextStream ts(&msg);
-
-    QFileInfo rootInfo(usrFilePath(QString("Welcomes/%1").arg(ev.from)));
-    if (rootInfo.isDir()) {
-        int i = 0;
-        QDir root(rootInfo.absoluteFilePath());
-        for (auto fileInfo : root.entryInfoList(QDir::Files, QDir::Name)) {
-            if (fileInfo.suffix() == "txt") {
-                QStringList nameParts = fileInfo.fileName().split('.');
-                if (nameParts.count() == 3) {
-                    QFile file(fileInfo.absoluteFilePath());
-                    if (file.open(QFile::ReadOnly)) {
-                        auto html = QString::fromUtf8(file.readAll());
-                        auto styleEnum = QMetaEnum::fromType<HtmlDraw::Style>();
-                        auto style = styleEnum.keysToValue(nameParts.at(1).toLatin1());
-                        auto image = d->htmlDraw->drawText(html, (HtmlDraw::Style)style, 400, ev.from);
-                        if (++i > 1) ts << '\n';
-                        ts << this->image(saveImage(image));
-                    }
-                }
-            }
+    // 静态的欢迎卡片已经预先渲染，这里只取出现成的消息。
+    WelcomeCards cards;
+    do {
+        QReadLocker locker(&d->welcomesGuard);
+        cards = d->welcomes.value(ev.from);
+    } while (false);
+
+    // 图片文件被清理时，这次只渲染缺失的卡片，整组的重新渲染交给 Qt 线程。
+    bool expired = false;
+    for (auto &card : cards.cards) {
+        if (card.fileName.isEmpty())
+            continue;
+
+        if (!QFile::exists(resFilePath(QString("image/%1").arg(card.fileName)))) {
+            card.fileName.clear();
+            expired = true;
+            continue;
         }
+        imageCollector()->touch(card.fileName);
+    }
+
+    if (expired) {
+        cards.message.clear();
+        d->expireWelcomes(ev.from);
     }
 
-    ts.flush();
+    // 引用了成员信息的卡片按加入的成员展开后再渲染。
+    QString msg = cards.message;
+    if (msg.isEmpty() && !cards.cards.isEmpty()) {
+        auto values = d->welcomeValues(ev.from, ev.member, nickName, nameCard, unknownLocation ? QString() : location);
+        msg = d->welcomeMessage(cards.cards, ev.from, values);
+    }
 
     if (!msg.isEmpty()) {
         sendGroupMessage(ev.from, at(ev.member));
@@ -125,8 +146,9 @@ bool AssistantModule::memberJoinEvent(const CoolQ::MemberJoinEvent &ev)
 bool AssistantModule::memberLeaveEvent(const CoolQ::MemberLeaveEvent &ev)
 {
     Q_D(AssistantModule);
+    AssistantConfigReader reader(d);
 
-    if (!d->managedGroups.contains(ev.from)) {
+    if (!d->snapshot()->policy(ev.from).managed) {
         return false;
     }
 
@@ -2,7 +2,16 @@
 
 #include "AssistantModule.h"
 #include "AssistantModule_p.h"
+#include "AssistantConfig.h"
 
+#include "CoolQApiMetrics.h"
+#include "CoolQFlightRecorder.h"
+#include "CoolQHandlerMetrics.h"
+#include "CoolQImageCollector.h"
+#include "CoolQTracer.h"
+#include "SqlDatas/MemberAuditlog.h"
+
+#include <QDateTime>
 #include <QDir>
 #include <QtDebug>
 #include <QStandardPaths>
@@ -84,12 +93,225 @@ bool PrivateCleanDataCaches::privateMessageFilter(int i, const CoolQ::MessageEve
 
     if (auto mm = qobject_cast<AssistantModule *>(module())) {
         if (mm->isSuperUser(ev.sender)) {
-            QString filePath = module()->resFilePath("image");
-            for (auto fileInfo : QDir(filePath).entryInfoList(QDir::Files)) {
-                QFile::remove(fileInfo.absoluteFilePath());
+            // 在回收线程中删除，最近引用过的图片会被保留。
+            mm->imageCollector()->purge();
+
+            mm->sendPrivateMessage(ev.sender, QString(u8"缓存清理已开始..."));
+        }
+    }
+
+    return true;
+}
+
+// class PrivateApiMetrics
+
+PrivateApiMetrics::PrivateApiMetrics(CoolQ::ServiceModule *parent)
+    : MessageFilter(parent)
+{
+}
+
+CoolQ::MessageFilter::Filters PrivateApiMetrics::filters() const
+{
+    return PrivateFilter;
+}
+
+QStringList PrivateApiMetrics::keywords() const
+{
+    QStringList keywords;
+
+    keywords << QString(u8"接口统计");
+    keywords << QString(u8"接口延迟");
+
+    return keywords;
+}
+
+bool PrivateApiMetrics::privateMessageFilter(int i, const CoolQ::MessageEvent &ev)
+{
+    Q_UNUSED(i);
+
+    if (auto mm = qobject_cast<AssistantModule *>(module())) {
+        if (mm->isSuperUser(ev.sender)) {
+            QString report = CoolQ::ApiMetrics::report();
+            if (report.isEmpty())
+                report = QString(u8"还没有接口调用...");
+
+            mm->sendPrivateMessage(ev.sender, report.trimmed());
+        }
+    }
+
+    return true;
+}
+
+// class PrivateRuntimeStatus
+
+PrivateRuntimeStatus::PrivateRuntimeStatus(CoolQ::ServiceModule *parent)
+    : MessageFilter(parent)
+{
+}
+
+CoolQ::MessageFilter::Filters PrivateRuntimeStatus::filters() const
+{
+    return PrivateFilter;
+}
+
+QStringList PrivateRuntimeStatus::keywords() const
+{
+    QStringList keywords;
+
+    keywords << QString(u8"状态");
+    keywords << QString(u8"运行状态");
+
+    return keywords;
+}
+
+bool PrivateRuntimeStatus::privateMessageFilter(int i, const CoolQ::MessageEvent &ev)
+{
+    Q_UNUSED(i);
+
+    if (auto mm = qobject_cast<AssistantModule *>(module())) {
+        if (mm->isSuperUser(ev.sender)) {
+            mm->showStatus(ev.sender);
+        }
+    }
+
+    return true;
+}
+
+// class PrivateHandlerMetrics
+
+PrivateHandlerMetrics::PrivateHandlerMetrics(CoolQ::ServiceModule *parent)
+    : MessageFilter(parent)
+{
+}
+
+CoolQ::MessageFilter::Filters PrivateHandlerMetrics::filters() const
+{
+    return PrivateFilter;
+}
+
+QStringList PrivateHandlerMetrics::keywords() const
+{
+    QStringList keywords;
+
+    keywords << QString(u8"热点统计");
+    keywords << QString(u8"处理耗时");
+
+    return keywords;
+}
+
+bool PrivateHandlerMetrics::privateMessageFilter(int i, const CoolQ::MessageEvent &ev)
+{
+    Q_UNUSED(i);
+
+    if (auto mm = qobject_cast<AssistantModule *>(module())) {
+        if (mm->isSuperUser(ev.sender)) {
+            QString report = CoolQ::HandlerMetrics::report();
+            if (report.isEmpty())
+                report = QString(u8"还没有处理过事件...");
+            else
+                report += QString(u8"预算：%1 ms").arg(CoolQ::HandlerMetrics::budget());
+
+            mm->sendPrivateMessage(ev.sender, report.trimmed());
+        }
+    }
+
+    return true;
+}
+
+// class PrivateFlightRecorder
+
+PrivateFlightRecorder::PrivateFlightRecorder(CoolQ::ServiceModule *parent)
+    : MessageFilter(parent)
+{
+}
+
+CoolQ::MessageFilter::Filters PrivateFlightRecorder::filters() const
+{
+    return PrivateFilter;
+}
+
+QStringList PrivateFlightRecorder::keywords() const
+{
+    QStringList keywords;
+
+    keywords << QString(u8"飞行记录");
+    keywords << QString(u8"导出记录");
+
+    return keywords;
+}
+
+bool PrivateFlightRecorder::privateMessageFilter(int i, const CoolQ::MessageEvent &ev)
+{
+    Q_UNUSED(i);
+
+    if (auto mm = qobject_cast<AssistantModule *>(module())) {
+        if (mm->isSuperUser(ev.sender)) {
+            QString fileName = CoolQ::FlightRecorder::dump("command");
+            if (fileName.isEmpty()) {
+                mm->sendPrivateMessage(ev.sender, QString(u8"飞行记录写入失败。"));
+            } else {
+                mm->sendPrivateMessage(ev.sender, QString(u8"飞行记录已导出：\n%1")
+                                       .arg(QDir::toNativeSeparators(fileName)));
             }
+        }
+    }
+
+    return true;
+}
+
+// class PrivateEventTracing
+
+PrivateEventTracing::PrivateEventTracing(CoolQ::ServiceModule *parent)
+    : MessageFilter(parent)
+{
+}
+
+CoolQ::MessageFilter::Filters PrivateEventTracing::filters() const
+{
+    return PrivateFilter;
+}
+
+QStringList PrivateEventTracing::keywords() const
+{
+    QStringList keywords;
 
-            mm->sendPrivateMessage(ev.sender, QString(u8"缓存清理完毕..."));
+    keywords << QString(u8"事件追踪");
+    keywords << QString(u8"追踪");
+
+    return keywords;
+}
+
+bool PrivateEventTracing::privateMessageFilter(int i, const CoolQ::MessageEvent &ev)
+{
+    if (auto mm = qobject_cast<AssistantModule *>(module())) {
+        if (!mm->isSuperUser(ev.sender))
+            return true;
+
+        QStringList args = CoolQ::trGbk(&ev.gbkMsg[i]).split(' ', QString::SkipEmptyParts);
+        QString action = args.value(0);
+
+        if (action == QString(u8"开启")) {
+            CoolQ::Tracer::clear();
+            CoolQ::Tracer::setEnabled(true);
+            mm->sendPrivateMessage(ev.sender, QString(u8"事件追踪已开启。"));
+        } else if (action == QString(u8"关闭")) {
+            CoolQ::Tracer::setEnabled(false);
+            mm->sendPrivateMessage(ev.sender, QString(u8"事件追踪已关闭。"));
+        } else if (action == QString(u8"导出")) {
+            // 导出为 Chrome Trace 格式，可以在 chrome://tracing 或 Perfetto 中打开。
+            QDir().mkpath(mm->usrFilePath("Traces"));
+            QString fileName = mm->usrFilePath(QString("Traces/trace-%1.json")
+                                               .arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss")));
+            int count = CoolQ::Tracer::dump(fileName);
+            if (count < 0) {
+                mm->sendPrivateMessage(ev.sender, QString(u8"追踪文件写入失败。"));
+            } else {
+                mm->sendPrivateMessage(ev.sender, QString(u8"已导出 %1 条追踪事件：\n%2")
+                                       .arg(count).arg(QDir::toNativeSeparators(fileName)));
+            }
+        } else {
+            mm->sendPrivateMessage(ev.sender, QString(u8"事件追踪%1。用法：追踪 开启|关闭|导出")
+                                   .arg(CoolQ::Tracer::isEnabled() ? QString(u8"已开启") : QString(u8"未开启")));
         }
     }
 
@@ -222,8 +444,8 @@ bool PrivateDeleteStartupShortcut::privateMessageFilter(int i, const CoolQ::Mess
 
 // class GroupBanHongbaoAction
 
-GroupBanHongbaoAction::GroupBanHongbaoAction(const QSet<qint64> &groups, CoolQ::ServiceModule *parent)
-    : MessageFilter(parent), monitoringGroups(groups)
+GroupBanHongbaoAction::GroupBanHongbaoAction(CoolQ::ServiceModule *parent)
+    : MessageFilter(parent)
 {
 }
 
@@ -238,11 +460,15 @@ bool GroupBanHongbaoAction::groupMessageFilter(int i, const CoolQ::MessageEvent
 
     if (auto mm = qobject_cast<AssistantModule *>(module())) {
         if (strncmp(ev.gbkMsg, "[CQ:hb", 6) == 0) {
-            if (monitoringGroups.contains(ev.from)) {
-                QString msg = QString(u8"<span class=\"warning\">行为警告！！！</span>本群禁止发送任何形式的红包。<br/>因此，您的行为将被禁言 %2 分钟，并通知相关管理员。").arg(60);
+            const auto &policy = mm->groupPolicy(ev.from);
+            if (policy.banHongbao) {
+                QString msg = QString(u8"<span class=\"warning\">行为警告！！！</span>本群禁止发送任何形式的红包。<br/>因此，您的行为将被禁言 %2 分钟，并通知相关管理员。").arg(policy.hongbaoBanTime / 60);
                 CoolQ::MemberInfo mi = mm->memberInfo(ev.from, ev.sender);
                 mm->showDanger(ev.from, mi.safetyName(), msg);
-                mm->banGroupMember(ev.from, ev.sender, 3600);
+                if (mm->banGroupMember(ev.from, ev.sender, policy.hongbaoBanTime) == CoolQ::ServiceModule::NoError) {
+                    mm->auditlog()->addRecord(ev.from, ev.sender, mm->currentId(),
+                                              MemberAuditlog::Ban, policy.hongbaoBanTime, QString(u8"红包"));
+                }
 
                 return true;
             }
@@ -671,6 +897,38 @@ bool GroupMemberInfoAction::groupMessageFilter(int i, const CoolQ::MessageEvent
     return true;
 }
 
+// class GroupAuditlogAction
+
+GroupAuditlogAction::GroupAuditlogAction(CoolQ::ServiceModule *parent)
+    : MessageFilter(parent)
+{
+}
+
+CoolQ::MessageFilter::Filters GroupAuditlogAction::filters() const
+{
+    return GroupFilter;
+}
+
+QStringList GroupAuditlogAction::keywords() const
+{
+    QStringList keywords;
+
+    keywords << QString(u8"最近操作");
+    keywords << QString(u8"操作记录");
+
+    return keywords;
+}
+
+bool GroupAuditlogAction::groupMessageFilter(int i, const CoolQ::MessageEvent &ev)
+{
+    if (auto mm = qobject_cast<AssistantModule *>(module())) {
+        QStringList args = CoolQ::trGbk(&ev.gbkMsg[i]).split(' ', QString::SkipEmptyParts);
+        mm->groupAuditlogAction(ev, args);
+    }
+
+    return true;
+}
+
 // class GroupRenameMemberHelpAction
 
 GroupRenameMemberHelpAction::GroupRenameMemberHelpAction(CoolQ::ServiceModule *parent)
@@ -1,8 +1,6 @@
 ﻿#ifndef ASSISTANTFILTERS_H
 #define ASSISTANTFILTERS_H
 
-#include <QSet>
-
 #include "CoolQMessageFilter.h"
 
 /*
@@ -43,6 +41,91 @@ public:
     bool privateMessageFilter(int i, const CoolQ::MessageEvent &ev) final;
 };
 
+// class PrivateApiMetrics
+
+class PrivateApiMetrics : public CoolQ::MessageFilter
+{
+    Q_OBJECT
+
+public:
+    explicit PrivateApiMetrics(CoolQ::ServiceModule *parent);
+
+public:
+    Filters filters() const final;
+    QStringList keywords() const final;
+
+public:
+    bool privateMessageFilter(int i, const CoolQ::MessageEvent &ev) final;
+};
+
+// class PrivateRuntimeStatus
+
+class PrivateRuntimeStatus : public CoolQ::MessageFilter
+{
+    Q_OBJECT
+
+public:
+    explicit PrivateRuntimeStatus(CoolQ::ServiceModule *parent);
+
+public:
+    Filters filters() const final;
+    QStringList keywords() const final;
+
+public:
+    bool privateMessageFilter(int i, const CoolQ::MessageEvent &ev) final;
+};
+
+// class PrivateHandlerMetrics
+
+class PrivateHandlerMetrics : public CoolQ::MessageFilter
+{
+    Q_OBJECT
+
+public:
+    explicit PrivateHandlerMetrics(CoolQ::ServiceModule *parent);
+
+public:
+    Filters filters() const final;
+    QStringList keywords() const final;
+
+public:
+    bool privateMessageFilter(int i, const CoolQ::MessageEvent &ev) final;
+};
+
+// class PrivateFlightRecorder
+
+class PrivateFlightRecorder : public CoolQ::MessageFilter
+{
+    Q_OBJECT
+
+public:
+    explicit PrivateFlightRecorder(CoolQ::ServiceModule *parent);
+
+public:
+    Filters filters() const final;
+    QStringList keywords() const final;
+
+public:
+    bool privateMessageFilter(int i, const CoolQ::MessageEvent &ev) final;
+};
+
+// class PrivateEventTracing
+
+class PrivateEventTracing : public CoolQ::MessageFilter
+{
+    Q_OBJECT
+
+public:
+    explicit PrivateEventTracing(CoolQ::ServiceModule *parent);
+
+public:
+    Filters filters() const final;
+    QStringList keywords() const final;
+
+public:
+    bool privateMessageFilter(int i, const CoolQ::MessageEvent &ev) final;
+};
+
 // class PrivateRestartComputer
 
 class PrivateRestartComputer : public CoolQ::MessageFilter
@@ -101,16 +184,13 @@ class GroupBanHongbaoAction : public CoolQ::MessageFilter
     Q_OBJECT
 
 public:
-    explicit GroupBanHongbaoAction(const QSet<qint64> &groups, CoolQ::ServiceModule *parent);
+    explicit GroupBanHongbaoAction(CoolQ::ServiceModule *parent);
 
 public:
     Filters filters() const final;
 
 public:
     bool groupMessageFilter(int i, const CoolQ::MessageEvent &ev) final;
-
-private:
-    QSet<qint64> monitoringGroups;
 };
 
 // class GroupCommandsAction
@@ -334,6 +414,23 @@ public:
     bool groupMessageFilter(int i, const CoolQ::MessageEvent &ev) final;
 };
 
+// class GroupAuditlogAction
+
+class GroupAuditlogAction : public CoolQ::MessageFilter
+{
+    Q_OBJECT
+
+public:
+    explicit GroupAuditlogAction(CoolQ::ServiceModule *parent);
+
+public:
+    Filters filters() const final;
+    QStringList keywords() const final;
+
+public:
+    bool groupMessageFilter(int i, const CoolQ::MessageEvent &ev) final;
+};
+
 // class GroupRenameMemberHelpAction
 
 class GroupRenameMemberHelpAction : public CoolQ::MessageFilter
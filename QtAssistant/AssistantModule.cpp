@@ -2,26 +2,47 @@
 #include "AssistantModule_p.h"
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QDateTime>
 #include <QDir>
-#include <QJsonArray>
+#include <QFileSystemWatcher>
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <QPixmap>
+#include <QSaveFile>
 #include <QStringBuilder>
-#include <QTextStream>
+#include <QTimer>
+#include <QTimerEvent>
 #include <QUuid>
 #include <QtDebug>
 #include <QMetaEnum>
 
+#include "CoolQApiMetrics.h"
+#include "CoolQHandlerMetrics.h"
+#include "CoolQImageCollector.h"
+#include "CoolQMetrics.h"
+#include "CoolQMetricsExporter.h"
+#include "CoolQTracer.h"
+
+#include "SqlDatas/MemberAuditlog.h"
 #include "SqlDatas/MemberWatchlist.h"
 #include "SqlDatas/MemberBlacklist.h"
 
+#include "HtmlDraw/HtmlCache.h"
 #include "HtmlDraw/HtmlDraw.h"
+#include "HtmlDraw/HtmlTemplate.h"
+#include "AssistantConfig.h"
 #include "AssistantFilters.h"
 
 // class AssistantModule
 
+// feedbackRows 每张卡片的条目数。
+static const int rowsPerCard = 5;
+
+// 名单卡片的列数，以及每列的行数上限，超过上限时才拆成多张卡片。
+static const int gridColumns = 2;
+static const int gridMaxLines = 32;
+
 AssistantModule::AssistantModule(CoolQ::ServiceEngine *engine)
     : CoolQ::ServiceModule(*new AssistantModulePrivate(), engine)
 {
@@ -32,22 +53,45 @@ AssistantModule::AssistantModule(CoolQ::ServiceEngine *engine)
 
     d->blacklist = new MemberBlacklist(this);
     d->watchlist = new MemberWatchlist(this);
+    d->auditlog = new MemberAuditlog(this);
 
-    new HtmlDraw(usrFilePath("Materials"), this);
+    d->htmlDraw = new HtmlDraw(usrFilePath("Materials"), this);
+    d->htmlCache = new HtmlCache();
+    d->metricsExporter = new CoolQ::MetricsExporter(usrFilePath("metrics.prom"), this);
 
     d->checkTimerId = startTimer(10000);
 
-    QFile file(usrFilePath("Assistant.json"));
-    if (file.open(QFile::ReadOnly)) {
-        auto doc = QJsonDocument::fromJson(file.readAll());
-        if (!doc.isEmpty() && doc.isObject()) {
-            d->init(doc.object());
-        }
-    }
+    // 预热使用配置中的渲染线程数，放在读取配置之后。
+    d->initConfig();
+    d->htmlDraw->warmUp();
+    d->initWelcomes();
+
+    if (d->metricsTimerId < 0)
+        d->metricsTimerId = startTimer(60 * 1000);
+
+    // 渲染、排版和审计日志的统计在读取时才采集。
+    CoolQ::Metrics::addSource(this, [d](CoolQ::Metrics::Gauges &gauges) {
+        auto lm = d->htmlDraw->layoutMetrics();
+        gauges.append({ "render_cache_hits_total", double(d->htmlCache->hits()) });
+        gauges.append({ "render_cache_misses_total", double(d->htmlCache->misses()) });
+        gauges.append({ "render_cache_entries", double(d->htmlCache->count()) });
+        gauges.append({ "layout_fast_total", double(lm.fastCount) });
+        gauges.append({ "layout_pooled_total", double(lm.pooledCount) });
+        gauges.append({ "layout_fresh_total", double(lm.freshCount) });
+        gauges.append({ "renders_total", double(d->renders.load()) });
+        gauges.append({ "list_cards_total", double(d->gridCards.load()) });
+        gauges.append({ "blacklist_hits_total", double(d->blacklistHits.load()) });
+        gauges.append({ "auditlog_pending", double(d->auditlog->pendingCount()) });
+    });
 
     // Private Commands
 
     new PrivateCleanDataCaches(this);
+    new PrivateApiMetrics(this);
+    new PrivateHandlerMetrics(this);
+    new PrivateRuntimeStatus(this);
+    new PrivateFlightRecorder(this);
+    new PrivateEventTracing(this);
     new PrivateRestartComputer(this);
 
     new PrivateCreateStartupShortcut(this);
@@ -55,7 +99,7 @@ AssistantModule::AssistantModule(CoolQ::ServiceEngine *engine)
 
     // Group Commands
 
-    new GroupBanHongbaoAction(d->banHongbaoGroups, this);
+    new GroupBanHongbaoAction(this);
 
     new GroupCommandsAction(this);
 
@@ -76,6 +120,8 @@ AssistantModule::AssistantModule(CoolQ::ServiceEngine *engine)
 
     new GroupMemberInfoAction(this);
 
+    new GroupAuditlogAction(this);
+
     // Group Help Commands
 
     new GroupRenameMemberHelpAction(this);
@@ -96,8 +142,33 @@ AssistantModule::~AssistantModule()
     Q_D(AssistantModule);
 
     AssistantModulePrivate::instance = nullptr;
+    delete d->metricsExporter;
+    CoolQ::Metrics::removeSource(this);
 
     killTimer(d->checkTimerId);
+    if (d->metricsTimerId > 0)
+        killTimer(d->metricsTimerId);
+    d->dumpMetrics();
+
+    qInfo("Render cache: %d hits, %d misses (%.1f%%).",
+          d->htmlCache->hits(), d->htmlCache->misses(), d->htmlCache->hitRate() * 100);
+
+    auto im = imageMetrics();
+    qInfo("Image encoder: %d images, %lld bytes, %lld ms, %d reused.", im.count, im.bytes, im.msecs, im.reused);
+
+    auto cm = imageCollector()->metrics();
+    qInfo("Image collector: %d passes, %d files (%lld bytes) removed, %d files (%lld bytes) left.",
+          cm.passes, cm.removedFiles, cm.removedBytes, cm.files, cm.bytes);
+
+    auto lm = d->htmlDraw->layoutMetrics();
+    qInfo("Text layout: %d fast (%lld us), %d pooled (%lld us), %d fresh (%lld us).",
+          lm.fastCount, lm.fastCount > 0 ? lm.fastTime / lm.fastCount : 0,
+          lm.pooledCount, lm.pooledCount > 0 ? lm.pooledTime / lm.pooledCount : 0,
+          lm.freshCount, lm.freshCount > 0 ? lm.freshTime / lm.freshCount : 0);
+
+    int cards = d->gridCards.load();
+    int chunks = d->gridChunks.load();
+    qInfo("List cards: %d images instead of %d, %d renders and sends saved.", cards, chunks, chunks - cards);
 }
 
 AssistantModule *AssistantModule::instance()
@@ -105,18 +176,32 @@ AssistantModule *AssistantModule::instance()
     return AssistantModulePrivate::instance;
 }
 
-void AssistantModule::timerEvent(QTimerEvent *)
+void AssistantModule::timerEvent(QTimerEvent *event)
 {
     Q_D(AssistantModule);
 
+    if (event->timerId() == d->metricsTimerId) {
+        CoolQ::Metrics::sample();
+        d->dumpMetrics();
+        return;
+    }
+
+    d->purgeConfigs(false);
+
     // 检查新手名单。
     do {
+        const AssistantConfig *config = d->snapshot();
         CoolQ::MemberList members;
-        d->watchlist->expiredMembers(members);
+        d->watchlist->expiredMembers(members, [config](qint64 gid) {
+            return config->policy(gid).watchTime * qint64(1000);
+        });
         for (const auto &member : members) {
             CoolQ::MemberInfo mi = memberInfo(member.first, member.second, false);
             if (mi.isValid() && mi.lastSent().isNull()) {
-                kickGroupMember(member.first, member.second, false);
+                if (kickGroupMember(member.first, member.second, false) == NoError) {
+                    d->auditlog->addRecord(member.first, member.second, currentId(),
+                                           MemberAuditlog::Kick, 0, QString(u8"观察超时"));
+                }
             }
         }
     } while (false);
@@ -149,10 +234,14 @@ void AssistantModule::showSuccess(qint64 gid, const QString &title, const QStrin
 
 void AssistantModule::feedback(qint64 gid, const QString &title, const QString &content, HtmlDraw::Style style)
 {
-    QString html = QString("<html><body><span class=\"t\">%1</span><p class=\"c\">%2</p></body></html>").arg(title, content);
+    static const HtmlTemplate html(QStringLiteral(
+        "<html><body><span class=\"t\">{{title}}</span><p class=\"c\">{{content}}</p></body></html>"));
+
+    QHash<QString, QString> values;
+    values.insert(QStringLiteral("title"), title);
+    values.insert(QStringLiteral("content"), content);
 
-    QPixmap feedback = HtmlDraw::drawText(html, style, 400, gid);
-    QString fileName = saveImage(feedback);
+    QString fileName = renderTemplate(html, values, style, groupPolicy(gid).cardWidth, gid);
     sendGroupMessage(gid, image(fileName));
 }
 
@@ -183,86 +272,207 @@ void AssistantModule::showSuccessList(qint64 gid, const QString &title, const QL
 
 void AssistantModule::feedbackList(qint64 gid, const QString &title, const QList<qint64> &members, HtmlDraw::Style style)
 {
-    for (int i = 0, part = 0; i < members.count();) {
-        QString html;
-        do {
-            int cc = i + 4;
-            QTextStream ds(&html);
-            ds << "<html><body><span class=\"t\">" << title;
-            if (members.count() > 5) {
-                ds << QString(u8"(第 %1 部分)").arg(++part);
+    QStringList rows;
+
+    for (qint64 uid : members) {
+        QString row;
+        CoolQ::MemberInfo mi = memberInfo(gid, uid);
+        if (mi.isValid()) {
+            if (!mi.nameCard().isEmpty()) {
+                row = mi.nameCard();
+            } else {
+                row = mi.nickName();
             }
-            ds << "</span><div>";
-            for (; i < members.count(); ++i) {
-                qint64 uid = members.at(i);
-                ds << "<p class=\"c\">";
-                CoolQ::MemberInfo mi = memberInfo(gid, uid);
-                if (mi.isValid()) {
-                    if (!mi.nameCard().isEmpty()) {
-                        ds << mi.nameCard();
-                    } else {
-                        ds << mi.nickName();
-                    }
-                } else {
-                    CoolQ::PersonInfo pi = personInfo(uid);
-                    if (pi.isValid()) {
-                        ds << pi.nickName();
-                    } else {
-                        ds << QString::number(uid);
-                    }
-                    ds << "<span>(" << QString(u8"不在本群") << ")</span>";
-                }
-                ds << "</p>";
+        } else {
+            CoolQ::PersonInfo pi = personInfo(uid);
+            if (pi.isValid()) {
+                row = pi.nickName();
+            } else {
+                row = QString::number(uid);
+            }
+            row += "<span>(" % QString(u8"不在本群") % ")</span>";
+        }
+        rows.append(row);
+    }
 
-                if (i == cc) {
-                    ++i;
-                    break;
-                }
+    feedbackGrid(gid, title, rows, style);
+}
+
+void AssistantModule::feedbackRows(qint64 gid, const QString &title, const QStringList &rows, HtmlDraw::Style style)
+{
+    static const HtmlTemplate html(QStringLiteral(
+        "<html><body><span class=\"t\">{{title}}</span><div>{{rows}}</div></body></html>"));
+
+    QStringList htmls;
+
+    for (int i = 0, part = 0; i < rows.count();) {
+        QHash<QString, QString> values;
+        if (rows.count() > rowsPerCard) {
+            values.insert(QStringLiteral("title"), title % QString(u8"(第 %1 部分)").arg(++part));
+        } else {
+            values.insert(QStringLiteral("title"), title);
+        }
+
+        QString text;
+        for (int cc = i + rowsPerCard - 1; i < rows.count(); ++i) {
+            text += QStringLiteral("<p class=\"c\">") % rows.at(i) % QStringLiteral("</p>");
+
+            if (i == cc) {
+                ++i;
+                break;
             }
-            ds << "</div></body></html>";
-        } while (false);
+        }
+        values.insert(QStringLiteral("rows"), text);
+
+        htmls.append(html.expand(values));
+    }
 
-        QPixmap feedback = HtmlDraw::drawText(html, style, 400, gid);
-        QString fileName = saveImage(feedback);
+    // 各部分互不依赖，并行渲染后再按顺序发送。
+    for (const auto &fileName : renderImages(htmls, style, groupPolicy(gid).cardWidth, gid)) {
         sendGroupMessage(gid, image(fileName));
     }
 }
 
-void AssistantModule::showWelcomes(qint64 gid, qint64 uid)
+void AssistantModule::feedbackGrid(qint64 gid, const QString &title, const QStringList &rows, HtmlDraw::Style style)
 {
     Q_D(AssistantModule);
 
-    if (!isSuperUser(uid)) {
+    static const HtmlTemplate html(QStringLiteral(
+        "<html><body><span class=\"t\">{{title}}</span>"
+        "<table width=\"100%\" cellspacing=\"0\" cellpadding=\"0\">{{rows}}</table></body></html>"));
+    static const QString cell = QString("<td width=\"%1%\">").arg(100 / gridColumns);
+
+    // 一张卡片放得下的短名单不需要分列。
+    if (rows.count() <= rowsPerCard) {
+        feedbackRows(gid, title, rows, style);
         return;
     }
 
-    QString msg;
-    QTextStream ts(&msg);
-
-    QFileInfo rootInfo(usrFilePath(QString("Welcomes/%1").arg(gid)));
-    if (rootInfo.isDir()) {
-        int i = 0;
-        QDir root(rootInfo.absoluteFilePath());
-        for (auto fileInfo : root.entryInfoList(QDir::Files, QDir::Name)) {
-            if (fileInfo.suffix() == "txt") {
-                QStringList nameParts = fileInfo.fileName().split('.');
-                if (nameParts.count() == 3) {
-                    QFile file(fileInfo.absoluteFilePath());
-                    if (file.open(QFile::ReadOnly)) {
-                        auto html = QString::fromUtf8(file.readAll());
-                        auto styleEnum = QMetaEnum::fromType<HtmlDraw::Style>();
-                        auto style = styleEnum.keysToValue(nameParts.at(1).toLatin1());
-                        auto image = d->htmlDraw->drawText(html, (HtmlDraw::Style)style, 400, gid);
-                        if (++i > 1) ts << '\n';
-                        ts << this->image(saveImage(image));
-                    }
-                }
+    const int rowsPerGrid = gridColumns * gridMaxLines;
+    const int parts = (rows.count() + rowsPerGrid - 1) / rowsPerGrid;
+
+    QStringList htmls;
+    for (int part = 0; part < parts; ++part) {
+        QStringList chunk = rows.mid(part * rowsPerGrid, rowsPerGrid);
+        int lines = (chunk.count() + gridColumns - 1) / gridColumns;
+
+        // 先填满一列再换下一列，保持名单从上到下的顺序。
+        QString text;
+        for (int line = 0; line < lines; ++line) {
+            text += QStringLiteral("<tr>");
+            for (int column = 0; column < gridColumns; ++column) {
+                int index = column * lines + line;
+                text += cell;
+                if (index < chunk.count())
+                    text += QStringLiteral("<p class=\"c\">") % chunk.at(index) % QStringLiteral("</p>");
+                text += QStringLiteral("</td>");
             }
+            text += QStringLiteral("</tr>");
+        }
+
+        QHash<QString, QString> values;
+        if (parts > 1) {
+            values.insert(QStringLiteral("title"), title % QString(u8"(第 %1 部分)").arg(part + 1));
+        } else {
+            values.insert(QStringLiteral("title"), title);
+        }
+        values.insert(QStringLiteral("rows"), text);
+
+        htmls.append(html.expand(values));
+    }
+
+    for (const auto &fileName : renderImages(htmls, style, groupPolicy(gid).cardWidth, gid)) {
+        sendGroupMessage(gid, image(fileName));
+    }
+
+    d->gridCards.fetchAndAddRelaxed(htmls.count());
+    d->gridChunks.fetchAndAddRelaxed((rows.count() + rowsPerCard - 1) / rowsPerCard);
+}
+
+QString AssistantModule::renderImage(const QString &html, HtmlDraw::Style style, int width, qint64 theme)
+{
+    return renderImages(QStringList() << html, style, width, theme).value(0);
+}
+
+QStringList AssistantModule::renderImages(const QStringList &htmls, HtmlDraw::Style style, int width, qint64 theme)
+{
+    Q_D(AssistantModule);
+    CQ_TRACE("AssistantModule::renderImages");
+
+    QStringList fileNames;
+    QVector<QByteArray> keys;
+    QVector<QFuture<QImage>> images;
+
+    // 相同的内容只渲染一次，直接复用已经写入的图片文件。没有定制素材的群组共用缓存。
+    qint64 themeId = HtmlDraw::themeId(theme);
+    for (const auto &html : htmls) {
+        QByteArray key = HtmlCache::key(html, style, width, themeId);
+        QString fileName = d->cachedImage(key);
+
+        keys.append(key);
+        fileNames.append(fileName);
+        images.append(fileName.isEmpty() ? HtmlDraw::drawTextAsync(html, style, width, theme)
+                                         : QFuture<QImage>());
+    }
+
+    for (int i = 0; i < fileNames.count(); ++i) {
+        if (fileNames.at(i).isEmpty()) {
+            do {
+                CQ_TRACE("HtmlDraw::drawText");
+                images.at(i).waitForFinished();
+            } while (false);
+
+            QString fileName = saveImage(images.at(i).result());
+            d->renders.fetchAndAddRelaxed(1);
+            d->htmlCache->insert(keys.at(i), fileName);
+            fileNames[i] = fileName;
         }
     }
 
-    ts.flush();
+    return fileNames;
+}
 
+QString AssistantModule::renderTemplate(const HtmlTemplate &html, const QHash<QString, QString> &values,
+                                        HtmlDraw::Style style, int width, qint64 theme)
+{
+    Q_D(AssistantModule);
+
+    // 缓存键由模板摘要和占位符的值得出，命中时不需要展开模板。
+    QByteArray key = HtmlCache::key(html, values, style, width, HtmlDraw::themeId(theme));
+    QString fileName = d->cachedImage(key);
+    if (fileName.isEmpty()) {
+        QImage image;
+        do {
+            CQ_TRACE("HtmlDraw::drawText");
+            image = HtmlDraw::drawText(html.expand(values), style, width, theme);
+        } while (false);
+
+        fileName = saveImage(image);
+        d->htmlCache->insert(key, fileName);
+        d->renders.fetchAndAddRelaxed(1);
+    }
+
+    return fileName;
+}
+
+void AssistantModule::showWelcomes(qint64 gid, qint64 uid)
+{
+    Q_D(AssistantModule);
+
+    if (!isSuperUser(uid)) {
+        return;
+    }
+
+    // 用发送命令的成员预览占位符展开后的效果。
+    QHash<QString, QString> values;
+    CoolQ::MemberInfo mi = memberInfo(gid, uid);
+    if (mi.isValid()) {
+        values = d->welcomeValues(gid, uid, mi.nickName(), mi.nameCard(), mi.location());
+    } else {
+        values = d->welcomeValues(gid, uid, QString(), QString(), QString());
+    }
+
+    QString msg = d->welcomeMessage(d->renderWelcomes(gid), gid, values);
     if (!msg.isEmpty())
         sendGroupMessage(gid, msg);
 }
@@ -287,7 +497,7 @@ void AssistantModule::saveWelcomes(qint64 gid, qint64 uid)
                         auto html = QString::fromUtf8(file.readAll());
                         auto styleEnum = QMetaEnum::fromType<HtmlDraw::Style>();
                         auto style = styleEnum.keysToValue(nameParts.at(1).toLatin1());
-                        auto image = HtmlDraw::drawText(html, (HtmlDraw::Style)style, 400, gid);
+                        auto image = HtmlDraw::drawText(html, (HtmlDraw::Style)style, groupPolicy(gid).cardWidth, gid);
                         auto fileName = imgFilePath(QString("Welcomes/%1.PNG").arg(nameParts.at(0)));
                         if (image.save(fileName, "PNG")) {
                             qInfo() << "Save Welcomes:" << fileName;
@@ -303,11 +513,122 @@ void AssistantModule::saveWelcomes(qint64 gid, qint64 uid)
     sendGroupMessage(gid, QString(u8"Save Welcomes finished"));
 }
 
+void AssistantModule::showStatus(qint64 uid)
+{
+    static const HtmlTemplate html(QStringLiteral(
+        "<html><body><span class=\"t\">{{title}}</span><div>{{rows}}</div></body></html>"));
+
+    auto msecs = [](quint32 usecs) { return QString::number(usecs / 1000.0, 'f', 1); };
+    auto megabytes = [](double bytes) { return QString::number(bytes / (1024 * 1024), 'f', 1); };
+
+    QHash<QByteArray, double> gauges;
+    for (const auto &gauge : CoolQ::Metrics::gauges())
+        gauges.insert(gauge.name, gauge.value);
+
+    QStringList rows;
+
+    qint64 uptime = CoolQ::Metrics::uptime() / 1000;
+    rows << QString(u8"运行时间：%1 天 %2 小时 %3 分")
+            .arg(uptime / 86400).arg(uptime % 86400 / 3600).arg(uptime % 3600 / 60);
+
+    qint64 memory = CoolQ::Metrics::memoryUsage();
+    if (memory >= 0)
+        rows << QString(u8"内存占用：%1 MB").arg(megabytes(memory));
+
+    // 事件速率，其它事件合并为一项。
+    QVector<double> rates = CoolQ::Metrics::rates();
+    double others = 0;
+    quint32 total = 0;
+    for (int i = 0; i < CoolQ::Metrics::EventCount; ++i) {
+        total += CoolQ::Metrics::count(CoolQ::Metrics::Event(i));
+        if (i > CoolQ::Metrics::DiscussMessage)
+            others += rates.at(i);
+    }
+    rows << QString(u8"事件/秒：群 %1，私聊 %2，讨论组 %3，其它 %4")
+            .arg(rates.at(CoolQ::Metrics::GroupMessage), 0, 'f', 2)
+            .arg(rates.at(CoolQ::Metrics::PrivateMessage), 0, 'f', 2)
+            .arg(rates.at(CoolQ::Metrics::DiscussMessage), 0, 'f', 2)
+            .arg(others, 0, 'f', 2);
+    rows << QString(u8"累计事件：%1").arg(total);
+
+    auto gl = CoolQ::Metrics::latency(CoolQ::Metrics::GroupMessage);
+    rows << QString(u8"群消息处理：p50 %1 ms，p99 %2 ms，最大 %3 ms")
+            .arg(msecs(gl.percentile(0.5))).arg(msecs(gl.percentile(0.99))).arg(msecs(gl.max));
+
+    // p99 最高的处理。
+    const CoolQ::HandlerMetrics::Entry *hottest = nullptr;
+    auto entries = CoolQ::HandlerMetrics::entries();
+    for (const auto &e : entries) {
+        if (e.name != metaObject()->className()
+                && (!hottest || e.latency.percentile(0.99) > hottest->latency.percentile(0.99)))
+            hottest = &e;
+    }
+    if (hottest) {
+        rows << QString(u8"最慢处理：%1，p99 %2 ms，超时 %3 次")
+                .arg(QString::fromLatin1(hottest->name)).arg(msecs(hottest->latency.percentile(0.99)))
+                .arg(hottest->slow);
+    }
+
+    auto ml = CoolQ::ApiMetrics::latency(CoolQ::ApiMetrics::GetGroupMemberInfo);
+    rows << QString(u8"成员信息查询：%1 次，p50 %2 ms，p99 %3 ms")
+            .arg(ml.count).arg(msecs(ml.percentile(0.5))).arg(msecs(ml.percentile(0.99)));
+
+    double hits = gauges.value("render_cache_hits_total");
+    double lookups = hits + gauges.value("render_cache_misses_total");
+    rows << QString(u8"渲染缓存：命中率 %1%，%2 项")
+            .arg(lookups > 0 ? hits * 100 / lookups : 0, 0, 'f', 1)
+            .arg(qint64(gauges.value("render_cache_entries")));
+
+    double encoded = gauges.value("image_encoded_total");
+    double reused = gauges.value("image_reused_total");
+    rows << QString(u8"图片复用：%1 / %2").arg(qint64(reused)).arg(qint64(encoded));
+
+    rows << QString(u8"图片目录：%1 个文件，%2 MB")
+            .arg(qint64(gauges.value("image_dir_files"))).arg(megabytes(gauges.value("image_dir_bytes")));
+
+    rows << QString(u8"审计日志待写入：%1").arg(qint64(gauges.value("auditlog_pending")));
+
+    QString text;
+    for (const auto &row : rows)
+        text += QStringLiteral("<p class=\"c\">") % row.toHtmlEscaped() % QStringLiteral("</p>");
+
+    QHash<QString, QString> values;
+    values.insert(QStringLiteral("title"), QString(u8"运行状态"));
+    values.insert(QStringLiteral("rows"), text);
+
+    // 状态每次都不同，不经过渲染缓存。
+    QString fileName = saveImage(HtmlDraw::drawText(html.expand(values), HtmlDraw::Primary, groupPolicy(0).cardWidth, 0));
+    sendPrivateMessage(uid, image(fileName));
+}
+
+// 返回当前的配置快照，在持有 AssistantConfigReader 的事件处理期间，以及在 Qt 线程中一直有效。
+const AssistantConfig *AssistantModule::config() const
+{
+    Q_D(const AssistantModule);
+
+    return d->snapshot();
+}
+
+// 返回群的策略记录，引用的有效期与 config() 相同。
+const GroupPolicy &AssistantModule::groupPolicy(qint64 gid) const
+{
+    Q_D(const AssistantModule);
+
+    return d->snapshot()->policy(gid);
+}
+
 bool AssistantModule::isSuperUser(qint64 uid) const
 {
     Q_D(const AssistantModule);
 
-    return d->superUsers.contains(uid);
+    return d->snapshot()->superUsers.contains(uid);
+}
+
+MemberAuditlog *AssistantModule::auditlog() const
+{
+    Q_D(const AssistantModule);
+
+    return d->auditlog;
 }
 
 // class AssistantModulePrivate
@@ -317,13 +638,26 @@ AssistantModule *AssistantModulePrivate::instance = nullptr;
 AssistantModulePrivate::AssistantModulePrivate()
     : watchlist(Q_NULLPTR)
     , blacklist(Q_NULLPTR)
+    , auditlog(Q_NULLPTR)
     , htmlDraw(Q_NULLPTR)
+    , htmlCache(Q_NULLPTR)
+    , welcomesWatcher(Q_NULLPTR)
+    , welcomesTimer(Q_NULLPTR)
+    , rescanWelcomes(false)
+    , metricsExporter(Q_NULLPTR)
     , checkTimerId(-1)
+    , metricsTimerId(-1)
+    , config(new AssistantConfig())
+    , configWatcher(Q_NULLPTR)
+    , configTimer(Q_NULLPTR)
 {
 }
 
 AssistantModulePrivate::~AssistantModulePrivate()
 {
+    purgeConfigs(true);
+    delete config.load();
+    delete htmlCache;
 }
 
 QList<qint64> AssistantModulePrivate::findUsers(const QStringList &args)
@@ -379,23 +713,533 @@ void AssistantModulePrivate::formatNameCard(QString &nameCard)
     nameCard.replace("】", "]"); // 替换全角方括号，用半角方括号替代。
 }
 
-void AssistantModulePrivate::init(const QJsonObject &o)
+void AssistantModulePrivate::initConfig()
+{
+    Q_Q(AssistantModule);
+
+    // 保存配置时编辑器往往是先删除再创建，同时监视所在目录。
+    configWatcher = new QFileSystemWatcher(q);
+    configTimer = new QTimer(q);
+    configTimer->setSingleShot(true);
+    configTimer->setInterval(500);
+
+    QObject::connect(configWatcher, &QFileSystemWatcher::fileChanged,
+                     q, [this]() { configTimer->start(); });
+    QObject::connect(configWatcher, &QFileSystemWatcher::directoryChanged,
+                     q, [this]() { configTimer->start(); });
+    QObject::connect(configTimer, &QTimer::timeout,
+                     q, [this]() { loadConfig(); watchConfig(); });
+
+    loadConfig();
+    watchConfig();
+}
+
+void AssistantModulePrivate::watchConfig()
+{
+    Q_Q(AssistantModule);
+
+    QString fileName = q->usrFilePath("Assistant.json");
+    QString dirName = QFileInfo(fileName).absolutePath();
+
+    if (!configWatcher->directories().contains(dirName) && QFileInfo(dirName).isDir())
+        configWatcher->addPath(dirName);
+    if (!configWatcher->files().contains(fileName) && QFileInfo(fileName).isFile())
+        configWatcher->addPath(fileName);
+}
+
+// 读取并检查 Assistant.json，通过后替换快照并应用其它设置。内容没有变化时不做任何事。
+bool AssistantModulePrivate::loadConfig()
 {
-    QJsonArray superUsers = o.value("superUsers").toArray();
-    for (int i = 0; i < superUsers.count(); ++i)
-        this->superUsers.insert(superUsers.at(i).toString().toLongLong());
+    Q_Q(AssistantModule);
 
-    QJsonArray managedGroups = o.value("managedGroups").toArray();
-    for (int i = 0; i < managedGroups.count(); ++i)
-        this->managedGroups.insert(managedGroups.at(i).toString().toLongLong());
+    QFile file(q->usrFilePath("Assistant.json"));
+    if (!file.open(QFile::ReadOnly))
+        return false;
 
-    QJsonArray banHongbaoGroups = o.value("banHongbaoGroups").toArray();
-    for (int i = 0; i < banHongbaoGroups.count(); ++i)
-        this->banHongbaoGroups.insert(banHongbaoGroups.at(i).toString().toLongLong());
+    QByteArray data = file.readAll();
+    QByteArray digest = QCryptographicHash::hash(data, QCryptographicHash::Md5);
+    if (digest == configDigest)
+        return true;
+
+    QJsonParseError parseError;
+    auto doc = QJsonDocument::fromJson(data, &parseError);
+    if (!doc.isObject()) {
+        qWarning() << "Assistant.json rejected:" << parseError.errorString();
+        return false;
+    }
+
+    QString errorString;
+    AssistantConfig *next = AssistantConfig::fromJson(doc.object(), &errorString);
+    if (!next) {
+        qWarning() << "Assistant.json rejected:" << errorString;
+        return false;
+    }
+
+    // 运行中不接受清空超级用户的修改，否则无法再通过命令管理。
+    if (!configDigest.isEmpty() && next->superUsers.isEmpty()) {
+        qWarning() << "Assistant.json rejected: superUsers is empty";
+        delete next;
+        return false;
+    }
+
+    bool reloading = !configDigest.isEmpty();
+    configDigest = digest;
+
+    const AssistantConfig *previous = config.fetchAndStoreOrdered(next);
+    retiredConfigs.append(previous);
+
+    // 文件中没有的项使用默认值，删除某一项即可恢复默认。
+    if (defaultSettings.isEmpty())
+        defaultSettings = currentSettings();
+
+    QJsonObject settings = defaultSettings;
+    for (auto iter = next->settings.constBegin(); iter != next->settings.constEnd(); ++iter)
+        settings.insert(iter.key(), iter.value());
+
+    applySettings(settings);
+
+    if (reloading)
+        qInfo() << "Assistant.json reloaded";
+    qInfo() << QString(u8"超级用户") << next->superUsers;
+    for (int i = 0; i < next->groupIds.count(); ++i) {
+        const auto &policy = next->groupPolicies.at(i);
+        qInfo("Group %lld: managed %d, banHongbao %d, hongbaoBanTime %d, watchTime %d, cardWidth %d, permission %d/%d",
+              next->groupIds.at(i), policy.managed, policy.banHongbao, policy.hongbaoBanTime,
+              policy.watchTime, policy.cardWidth, policy.orderPermission, policy.targetPermission);
+    }
+
+    return true;
+}
+
+// 事件线程进入事件处理时登记为读者，返回登记的位置。
+int AssistantModulePrivate::enterConfig()
+{
+    // 登记后纪元没有变化，才能保证清理时看得到这次登记。
+    forever {
+        int epoch = configEpoch.loadAcquire();
+        configReaders[epoch & 1].ref();
+        if (configEpoch.loadAcquire() == epoch)
+            return epoch & 1;
+        configReaders[epoch & 1].deref();
+    }
+}
 
-    qInfo() << QString(u8"超级用户") << this->superUsers;
-    qInfo() << QString(u8"管理群组") << this->managedGroups;
-    qInfo() << QString(u8"屏蔽红包") << this->banHongbaoGroups;
+void AssistantModulePrivate::leaveConfig(int slot)
+{
+    configReaders[slot].deref();
+}
+
+// 在 Qt 线程中定期调用。上一个纪元的读者全部结束后，删除上一个纪元之前替换下来的快照，
+// 再把这个纪元替换下来的快照交给下一轮并切换纪元。all 为 true 时全部删除，只在析构时使用。
+void AssistantModulePrivate::purgeConfigs(bool all)
+{
+    if (all) {
+        qDeleteAll(drainingConfigs);
+        qDeleteAll(retiredConfigs);
+        drainingConfigs.clear();
+        retiredConfigs.clear();
+        return;
+    }
+
+    int epoch = configEpoch.loadAcquire();
+    if (configReaders[(epoch + 1) & 1].loadAcquire() != 0)
+        return;
+
+    qDeleteAll(drainingConfigs);
+    drainingConfigs = retiredConfigs;
+    retiredConfigs.clear();
+
+    configEpoch.fetchAndStoreOrdered(epoch + 1);
+}
+
+// 以配置文件的格式返回当前生效的设置。
+QJsonObject AssistantModulePrivate::currentSettings() const
+{
+    Q_Q(const AssistantModule);
+
+    static const char *const formats[] = { "png", "jpeg", "webp", "auto" };
+
+    auto collector = q->imageCollector();
+
+    QJsonObject o;
+    o.insert("handlerBudget", CoolQ::HandlerMetrics::budget());
+    o.insert("tracing", CoolQ::Tracer::isEnabled());
+    o.insert("renderCacheSize", htmlCache->maxCount());
+    o.insert("renderWorkers", htmlDraw->workerCount());
+    o.insert("renderThemes", htmlDraw->maxThemeCount());
+    o.insert("renderColors", htmlDraw->paletteSize());
+    o.insert("renderDithering", htmlDraw->isDithering());
+    o.insert("imageFormat", QString::fromLatin1(formats[q->imageFormat()]));
+    o.insert("imageQuality", q->imageQuality());
+    o.insert("imageCacheSize", int(collector->maxBytes() / 1024 / 1024));
+    o.insert("imageCacheFiles", collector->maxFiles());
+    o.insert("imageCacheProtect", collector->protectMinutes());
+    o.insert("metricsInterval", 60);
+    o.insert("metricsExport", metricsExporter->interval());
+    return o;
+}
+
+void AssistantModulePrivate::applySettings(const QJsonObject &o)
+{
+    Q_Q(AssistantModule);
+
+    // 单次事件处理的预算（毫秒），超出时记录日志。
+    if (o.contains("handlerBudget"))
+        CoolQ::HandlerMetrics::setBudget(o.value("handlerBudget").toInt());
+
+    // 启动时即开启事件追踪，便于排查启动阶段的耗时。
+    if (o.contains("tracing"))
+        CoolQ::Tracer::setEnabled(o.value("tracing").toBool());
+
+    if (o.contains("renderCacheSize"))
+        htmlCache->setMaxCount(o.value("renderCacheSize").toInt());
+
+    if (o.contains("renderWorkers"))
+        htmlDraw->setWorkerCount(o.value("renderWorkers").toInt());
+
+    if (o.contains("renderThemes"))
+        htmlDraw->setMaxThemeCount(o.value("renderThemes").toInt());
+
+    // 调色板参数不在缓存键中，变化后已缓存的图片都不再适用。
+    int paletteSize = htmlDraw->paletteSize();
+    bool dithering = htmlDraw->isDithering();
+
+    if (o.contains("renderColors"))
+        htmlDraw->setPaletteSize(o.value("renderColors").toInt());
+
+    if (o.contains("renderDithering"))
+        htmlDraw->setDithering(o.value("renderDithering").toBool());
+
+    if (htmlDraw->paletteSize() != paletteSize || htmlDraw->isDithering() != dithering) {
+        htmlCache->clear();
+
+        // 启动时欢迎卡片还没有渲染，重新加载配置时才需要重新渲染。
+        if (welcomesTimer) {
+            rescanWelcomes = true;
+            welcomesTimer->start();
+        }
+    }
+
+    // 图片编码策略：auto、png、jpeg 或 webp。
+    if (o.contains("imageFormat")) {
+        QString format = o.value("imageFormat").toString().toLower();
+        if (format == "png") {
+            q->setImageFormat(CoolQ::ServiceModule::PngFormat);
+        } else if (format == "jpeg" || format == "jpg") {
+            q->setImageFormat(CoolQ::ServiceModule::JpegFormat);
+        } else if (format == "webp") {
+            q->setImageFormat(CoolQ::ServiceModule::WebpFormat);
+        } else {
+            q->setImageFormat(CoolQ::ServiceModule::AutoFormat);
+        }
+    }
+
+    if (o.contains("imageQuality"))
+        q->setImageQuality(o.value("imageQuality").toInt());
+
+    // 图片目录的限额：总大小（MB）、文件数，以及最近引用的保护时间（分钟）。
+    auto collector = q->imageCollector();
+    if (o.contains("imageCacheSize"))
+        collector->setMaxBytes(qint64(o.value("imageCacheSize").toInt()) * 1024 * 1024);
+
+    if (o.contains("imageCacheFiles"))
+        collector->setMaxFiles(o.value("imageCacheFiles").toInt());
+
+    if (o.contains("imageCacheProtect"))
+        collector->setProtectMinutes(o.value("imageCacheProtect").toInt());
+
+    // 接口统计写入文件的间隔（秒），0 表示不写入。
+    if (o.contains("metricsInterval")) {
+        if (metricsTimerId > 0)
+            q->killTimer(metricsTimerId);
+
+        int interval = o.value("metricsInterval").toInt();
+        metricsTimerId = interval > 0 ? q->startTimer(interval * 1000) : 0;
+    }
+
+    // Prometheus 统计文件的导出间隔（秒），0 表示不导出。
+    if (o.contains("metricsExport"))
+        metricsExporter->setInterval(o.value("metricsExport").toInt());
+}
+
+void AssistantModulePrivate::initWelcomes()
+{
+    Q_Q(AssistantModule);
+
+    // 欢迎卡片在启动时渲染一次，之后只在文件变化时重新渲染。
+    welcomesWatcher = new QFileSystemWatcher(q);
+    welcomesTimer = new QTimer(q);
+    welcomesTimer->setSingleShot(true);
+    welcomesTimer->setInterval(500);
+
+    QObject::connect(welcomesWatcher, &QFileSystemWatcher::directoryChanged,
+                     q, [this](const QString &path) { welcomesChanged(path); });
+    QObject::connect(welcomesWatcher, &QFileSystemWatcher::fileChanged,
+                     q, [this](const QString &path) { welcomesChanged(path); });
+    QObject::connect(welcomesTimer, &QTimer::timeout,
+                     q, [this]() { reloadWelcomes(); });
+
+    watchWelcomes();
+
+    for (qint64 gid : welcomeGroups())
+        updateWelcomes(gid);
+}
+
+void AssistantModulePrivate::watchWelcomes()
+{
+    Q_Q(AssistantModule);
+
+    QStringList roots;
+    roots << q->usrFilePath("Welcomes");
+    roots << htmlDraw->materialPath();
+
+    QStringList paths;
+    for (const auto &rootPath : roots) {
+        QDir root(rootPath);
+        if (!root.exists())
+            continue;
+
+        paths << rootPath;
+        for (const auto &fileInfo : root.entryInfoList(QDir::Files))
+            paths << fileInfo.absoluteFilePath();
+
+        for (const auto &dirInfo : root.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            paths << dirInfo.absoluteFilePath();
+            for (const auto &fileInfo : QDir(dirInfo.absoluteFilePath()).entryInfoList(QDir::Files))
+                paths << fileInfo.absoluteFilePath();
+        }
+    }
+
+    // 编辑器保存文件时往往是先删除再创建，需要重新加入监视。
+    QStringList watched = welcomesWatcher->directories() + welcomesWatcher->files();
+    QStringList added;
+    for (const auto &path : paths) {
+        if (!watched.contains(path))
+            added << path;
+    }
+
+    if (!added.isEmpty())
+        welcomesWatcher->addPaths(added);
+}
+
+void AssistantModulePrivate::welcomesChanged(const QString &path)
+{
+    Q_Q(AssistantModule);
+
+    QString welcomesPath = q->usrFilePath("Welcomes");
+    QString materialsPath = htmlDraw->materialPath();
+
+    if (path.startsWith(welcomesPath)) {
+        qint64 gid = path.mid(welcomesPath.length() + 1).section('/', 0, 0).toLongLong();
+        if (gid != 0) {
+            dirtyWelcomes.insert(gid);
+        } else {
+            rescanWelcomes = true;
+        }
+    } else if (path.startsWith(materialsPath)) {
+        qint64 gid = path.mid(materialsPath.length() + 1).section('/', 0, 0).toLongLong();
+        dirtyMaterials.insert(gid);
+    }
+
+    welcomesTimer->start();
+}
+
+void AssistantModulePrivate::reloadWelcomes()
+{
+    do {
+        QMutexLocker locker(&expiredGuard);
+        dirtyWelcomes.unite(expiredWelcomes);
+        expiredWelcomes.clear();
+    } while (false);
+
+    if (!dirtyMaterials.isEmpty()) {
+        htmlDraw->updateMaterials();
+        htmlCache->clear();
+
+        // 默认素材变化时，所有群组的卡片都需要重新渲染。
+        if (dirtyMaterials.contains(0)) {
+            rescanWelcomes = true;
+        } else {
+            dirtyWelcomes.unite(dirtyMaterials);
+        }
+        dirtyMaterials.clear();
+    }
+
+    watchWelcomes();
+
+    QSet<qint64> gids = dirtyWelcomes;
+    if (rescanWelcomes) {
+        QReadLocker locker(&welcomesGuard);
+        gids.unite(welcomes.keys().toSet());
+        gids.unite(welcomeGroups().toSet());
+    }
+
+    dirtyWelcomes.clear();
+    rescanWelcomes = false;
+
+    for (qint64 gid : gids) {
+        updateWelcomes(gid);
+        qInfo("Welcomes reloaded: %lld.", gid);
+    }
+}
+
+QList<qint64> AssistantModulePrivate::welcomeGroups() const
+{
+    Q_Q(const AssistantModule);
+
+    QList<qint64> gids;
+
+    QDir root(q->usrFilePath("Welcomes"));
+    for (const auto &dirInfo : root.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        qint64 gid = dirInfo.fileName().toLongLong();
+        if (gid != 0)
+            gids.append(gid);
+    }
+
+    return gids;
+}
+
+QVector<WelcomeCard> AssistantModulePrivate::renderWelcomes(qint64 gid)
+{
+    Q_Q(AssistantModule);
+
+    QVector<WelcomeCard> cards;
+
+    QFileInfo rootInfo(q->usrFilePath(QString("Welcomes/%1").arg(gid)));
+    if (rootInfo.isDir()) {
+        auto styleEnum = QMetaEnum::fromType<HtmlDraw::Style>();
+        QDir root(rootInfo.absoluteFilePath());
+        for (auto fileInfo : root.entryInfoList(QDir::Files, QDir::Name)) {
+            if (fileInfo.suffix() == "txt") {
+                QStringList nameParts = fileInfo.fileName().split('.');
+                if (nameParts.count() == 3) {
+                    QFile file(fileInfo.absoluteFilePath());
+                    if (file.open(QFile::ReadOnly)) {
+                        WelcomeCard card;
+                        card.html = HtmlTemplate(QString::fromUtf8(file.readAll()));
+                        card.style = (HtmlDraw::Style)styleEnum.keysToValue(nameParts.at(1).toLatin1());
+
+                        // 引用了成员信息的卡片只能在成员加入时渲染。
+                        if (card.html.isStatic()) {
+                            card.fileName = q->renderTemplate(card.html, QHash<QString, QString>(),
+                                                              card.style, q->groupPolicy(gid).cardWidth, gid);
+                            if (card.fileName.isEmpty())
+                                continue;
+                        }
+
+                        cards.append(card);
+                    }
+                }
+            }
+        }
+    }
+
+    return cards;
+}
+
+void AssistantModulePrivate::updateWelcomes(qint64 gid)
+{
+    Q_Q(AssistantModule);
+
+    WelcomeCards cards;
+    cards.cards = renderWelcomes(gid);
+    for (const auto &card : cards.cards) {
+        if (card.fileName.isEmpty()) {
+            cards.message.clear();
+            break;
+        }
+
+        if (!cards.message.isEmpty())
+            cards.message += '\n';
+        cards.message += q->image(card.fileName);
+    }
+
+    // 预先渲染的卡片可能很久没有成员加入，固定在图片目录中，直到被新的卡片替换。
+    for (const auto &card : cards.cards)
+        q->imageCollector()->pin(card.fileName);
+
+    QWriteLocker locker(&welcomesGuard);
+    for (const auto &card : welcomes.value(gid).cards)
+        q->imageCollector()->unpin(card.fileName);
+
+    if (cards.cards.isEmpty()) {
+        welcomes.remove(gid);
+    } else {
+        welcomes.insert(gid, cards);
+    }
+}
+
+// 在 CoolQ 的线程中调用，计时器只能在所属的 Qt 线程中启动。
+void AssistantModulePrivate::expireWelcomes(qint64 gid)
+{
+    QMutexLocker locker(&expiredGuard);
+    expiredWelcomes.insert(gid);
+    QMetaObject::invokeMethod(welcomesTimer, "start", Qt::QueuedConnection);
+}
+
+QHash<QString, QString> AssistantModulePrivate::welcomeValues(qint64 gid, qint64 uid, const QString &nickName,
+                                                              const QString &nameCard, const QString &location)
+{
+    // 成员资料由用户填写，需要转义后才能放进卡片。
+    QHash<QString, QString> values;
+    values.insert(QStringLiteral("group"), QString::number(gid));
+    values.insert(QStringLiteral("member"), QString::number(uid));
+    values.insert(QStringLiteral("nickname"), nickName.toHtmlEscaped());
+    values.insert(QStringLiteral("name"), (nameCard.isEmpty() ? nickName : nameCard).toHtmlEscaped());
+    values.insert(QStringLiteral("location"), location.toHtmlEscaped());
+    return values;
+}
+
+QString AssistantModulePrivate::welcomeMessage(const QVector<WelcomeCard> &cards, qint64 gid,
+                                               const QHash<QString, QString> &values)
+{
+    Q_Q(AssistantModule);
+
+    QString msg;
+    for (const auto &card : cards) {
+        QString fileName = card.fileName;
+        if (fileName.isEmpty())
+            fileName = q->renderTemplate(card.html, values, card.style, q->groupPolicy(gid).cardWidth, gid);
+        if (fileName.isEmpty())
+            continue;
+
+        if (!msg.isEmpty())
+            msg += '\n';
+        msg += q->image(fileName);
+    }
+
+    return msg;
+}
+
+QString AssistantModulePrivate::cachedImage(const QByteArray &key)
+{
+    Q_Q(AssistantModule);
+
+    // 图片文件可能已经被清理，这时按未命中处理。先标记再检查，回收器不会在检查之后删除它。
+    QString fileName = htmlCache->object(key);
+    if (!fileName.isEmpty()) {
+        q->imageCollector()->touch(fileName);
+        if (!QFile::exists(q->resFilePath(QString("image/%1").arg(fileName)))) {
+            htmlCache->invalidate(key);
+            fileName.clear();
+        }
+    }
+
+    return fileName;
+}
+
+void AssistantModulePrivate::dumpMetrics()
+{
+    Q_Q(AssistantModule);
+
+    QSaveFile file(q->usrFilePath("ApiMetrics.txt"));
+    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        file.write(QDateTime::currentDateTime().toString(Qt::ISODate).toUtf8() + '\n');
+        file.write(CoolQ::ApiMetrics::report().toUtf8());
+        file.write("\n");
+        file.write(CoolQ::HandlerMetrics::report(0).toUtf8());
+        file.commit();
+    }
 }
 
 void AssistantModulePrivate::saveWelcomes(const QString &id, HtmlDraw::Style style)
@@ -406,7 +1250,7 @@ void AssistantModulePrivate::saveWelcomes(const QString &id, HtmlDraw::Style sty
     if (file.open(QFile::ReadOnly)) {
         auto htmlText = QString::fromUtf8(file.readAll());
 
-        QPixmap image = htmlDraw->drawText(htmlText, style, 400, 0);
+        QImage image = htmlDraw->drawText(htmlText, style, q->groupPolicy(0).cardWidth, 0);
         if (image.save(q->imgFilePath(QString("Welcomes/%1.png").arg(id)), "PNG")) {
             qInfo() << "Output 1";
         } else {
@@ -5,6 +5,11 @@
 
 #include "HtmlDraw/HtmlDraw.h"
 
+class MemberAuditlog;
+class HtmlTemplate;
+class AssistantConfig;
+struct GroupPolicy;
+
 // class AssistantModule
 
 class AssistantModulePrivate;
@@ -55,6 +60,8 @@ public:
 
     void groupMemberAction(const CoolQ::MessageEvent &ev, const QStringList &args);
 
+    void groupAuditlogAction(const CoolQ::MessageEvent &ev, const QStringList &args);
+
 public:
     void groupRenameHelpAction(qint64 gid);
     void groupFormatHelpAction(qint64 gid);
@@ -85,13 +92,26 @@ public:
     void showSuccessList(qint64 gid, const QString &title, const QList<qint64> &members);
 
     void feedbackList(qint64 gid, const QString &title, const QList<qint64> &members, HtmlDraw::Style style);
+    void feedbackRows(qint64 gid, const QString &title, const QStringList &rows, HtmlDraw::Style style);
+    void feedbackGrid(qint64 gid, const QString &title, const QStringList &rows, HtmlDraw::Style style);
+
+    QString renderImage(const QString &html, HtmlDraw::Style style, int width, qint64 theme);
+    QStringList renderImages(const QStringList &htmls, HtmlDraw::Style style, int width, qint64 theme);
+    QString renderTemplate(const HtmlTemplate &html, const QHash<QString, QString> &values,
+                           HtmlDraw::Style style, int width, qint64 theme);
 
 public:
     void showWelcomes(qint64 gid, qint64 uid);
     void saveWelcomes(qint64 gid, qint64 uid);
 
 public:
+    void showStatus(qint64 uid);
+
+public:
+    const AssistantConfig *config() const;
+    const GroupPolicy &groupPolicy(qint64 gid) const;
     bool isSuperUser(qint64 uid) const;
+    MemberAuditlog *auditlog() const;
 };
 
 #endif // ASSISTANTMODULE_H
@@ -1,13 +1,42 @@
 ﻿#ifndef ASSISTANTMODULE_P_H
 #define ASSISTANTMODULE_P_H
 
+#include <QAtomicInt>
+#include <QMutex>
+#include <QReadWriteLock>
 #include <QSet>
 
 #include "CoolQServiceModule_p.h"
 #include "AssistantModule.h"
 
+#include "HtmlDraw/HtmlTemplate.h"
+
+class QFileSystemWatcher;
+class QTimer;
+
 class MemberWatchlist;
 class MemberBlacklist;
+class MemberAuditlog;
+class HtmlCache;
+class AssistantConfig;
+
+namespace CoolQ {
+class MetricsExporter;
+}
+
+struct WelcomeCard
+{
+    HtmlTemplate html;
+    HtmlDraw::Style style;
+    QString fileName;
+};
+
+struct WelcomeCards
+{
+    // 不含占位符的卡片预先渲染，全部是这种卡片时 message 才有内容。
+    QVector<WelcomeCard> cards;
+    QString message;
+};
 
 class AssistantModulePrivate : public CoolQ::ServiceModulePrivate
 {
@@ -27,23 +56,110 @@ public:
     static void formatNameCard(QString &nameCard);
 
 protected:
-    void init(const QJsonObject &o);
+    void initConfig();
+    void watchConfig();
+    bool loadConfig();
+    void applySettings(const QJsonObject &o);
+    QJsonObject currentSettings() const;
+    void purgeConfigs(bool all);
+
+public:
+    const AssistantConfig *snapshot() const { return config.loadAcquire(); }
+
+    int enterConfig();
+    void leaveConfig(int slot);
 
 private:
-    QSet<qint64> superUsers;
-    QSet<qint64> managedGroups;
-    QSet<qint64> banHongbaoGroups;
+    // 事件线程只读取当前快照。读者按纪元的奇偶登记，替换下来的快照要等替换之前开始的读者
+    // 全部结束后才删除，与事件处理用了多长时间无关。
+    QAtomicPointer<const AssistantConfig> config;
+    QAtomicInt configEpoch;
+    QAtomicInt configReaders[2];
+    QList<const AssistantConfig *> retiredConfigs;
+    QList<const AssistantConfig *> drainingConfigs;
+    QByteArray configDigest;
+
+    // 第一次加载配置之前的设置，文件中删除的项恢复为这些值。
+    QJsonObject defaultSettings;
+
+    QFileSystemWatcher *configWatcher;
+    QTimer *configTimer;
 
 protected:
     void saveWelcomes(const QString &id, HtmlDraw::Style style);
 
+protected:
+    void initWelcomes();
+    void watchWelcomes();
+    void welcomesChanged(const QString &path);
+    void reloadWelcomes();
+
+    QList<qint64> welcomeGroups() const;
+    QVector<WelcomeCard> renderWelcomes(qint64 gid);
+    void updateWelcomes(qint64 gid);
+    void expireWelcomes(qint64 gid);
+
+    static QHash<QString, QString> welcomeValues(qint64 gid, qint64 uid, const QString &nickName,
+                                                 const QString &nameCard, const QString &location);
+    QString welcomeMessage(const QVector<WelcomeCard> &cards, qint64 gid, const QHash<QString, QString> &values);
+
+protected:
+    QString cachedImage(const QByteArray &key);
+
+private:
+    QHash<qint64, WelcomeCards> welcomes;
+    mutable QReadWriteLock welcomesGuard;
+
+    QFileSystemWatcher *welcomesWatcher;
+    QTimer *welcomesTimer;
+
+    QSet<qint64> dirtyWelcomes;
+    QSet<qint64> dirtyMaterials;
+    bool rescanWelcomes;
+
+    // 事件线程发现图片已被清理的群组，由 Qt 线程统一重新渲染。
+    QSet<qint64> expiredWelcomes;
+    QMutex expiredGuard;
+
 private:
     MemberWatchlist *watchlist;
     MemberBlacklist *blacklist;
+    MemberAuditlog *auditlog;
 
     HtmlDraw *htmlDraw;
+    HtmlCache *htmlCache;
+
+    // 名单卡片实际发送的图片数，以及按每张五条拆分时需要的图片数。
+    QAtomicInt gridCards;
+    QAtomicInt gridChunks;
+
+    // 实际渲染的卡片数，以及黑名单拦截的次数。
+    QAtomicInt renders;
+    QAtomicInt blacklistHits;
+
+    CoolQ::MetricsExporter *metricsExporter;
 
     int checkTimerId;
+
+protected:
+    void dumpMetrics();
+
+private:
+    int metricsTimerId;
+};
+
+// 事件处理期间持有配置快照，析构之前 config() 和 groupPolicy() 返回的指针一直有效。
+class AssistantConfigReader
+{
+    Q_DISABLE_COPY(AssistantConfigReader)
+
+public:
+    explicit AssistantConfigReader(AssistantModulePrivate *d) : d(d), slot(d->enterConfig()) {}
+    ~AssistantConfigReader() { d->leaveConfig(slot); }
+
+private:
+    AssistantModulePrivate *d;
+    int slot;
 };
 
 #endif // ASSISTANTMODULE_P_H
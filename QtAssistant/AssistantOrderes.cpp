@@ -1,18 +1,84 @@
 ﻿#include "AssistantModule.h"
 #include "AssistantModule_p.h"
+#include "AssistantConfig.h"
 
+#include <QDateTime>
 #include <QRegularExpression>
 #include <QStringBuilder>
 #include <QTextStream>
 #include <QtDebug>
 
+#include "SqlDatas/MemberAuditlog.h"
 #include "SqlDatas/MemberWatchlist.h"
 #include "SqlDatas/MemberBlacklist.h"
 
+static QString auditActionName(qint32 action)
+{
+    switch (action) {
+    case MemberAuditlog::Ban:
+        return QString(u8"禁言");
+    case MemberAuditlog::Unban:
+        return QString(u8"解禁");
+    case MemberAuditlog::Kick:
+        return QString(u8"踢出");
+    case MemberAuditlog::Rename:
+        return QString(u8"修改名片");
+    case MemberAuditlog::AddWatchlist:
+        return QString(u8"加入观察室");
+    case MemberAuditlog::RemoveWatchlist:
+        return QString(u8"移出观察室");
+    case MemberAuditlog::AddBlacklist:
+        return QString(u8"加入黑名单");
+    case MemberAuditlog::RemoveBlacklist:
+        return QString(u8"移出黑名单");
+    case MemberAuditlog::RejectRequest:
+        return QString(u8"拒绝加群");
+    default:
+        break;
+    }
+
+    return QString::number(action);
+}
+
+static QString auditDuration(qint64 duration)
+{
+    QString text;
+
+    if (duration >= 86400)
+        text += QString(u8"%1 天").arg(duration / 86400);
+    if ((duration % 86400) >= 3600)
+        text += QString(u8"%1 小时").arg((duration % 86400) / 3600);
+    if ((duration % 3600) >= 60)
+        text += QString(u8"%1 分钟").arg((duration % 3600) / 60);
+
+    // 不足一分钟时按秒显示，避免输出空的括号。
+    if (text.isEmpty())
+        text = QString(u8"%1 秒").arg(duration);
+
+    return text;
+}
+
+static QString permissionName(int permission)
+{
+    switch (permission) {
+    case 1:
+        return QString(u8"成员");
+    case 2:
+        return QString(u8"管理员");
+    case 3:
+        return QString(u8"群主");
+    }
+
+    return QString::number(permission);
+}
+
 // class AssistantModule
 
 bool AssistantModule::privateMessageEvent(const CoolQ::MessageEvent &ev)
 {
+    Q_D(AssistantModule);
+    AssistantConfigReader reader(d);
+
     if (CoolQ::ServiceModule::privateMessageEvent(ev)) {
         return true;
     }
@@ -23,8 +89,9 @@ bool AssistantModule::privateMessageEvent(const CoolQ::MessageEvent &ev)
 bool AssistantModule::groupMessageEvent(const CoolQ::MessageEvent &ev)
 {
     Q_D(AssistantModule);
+    AssistantConfigReader reader(d);
 
-    if (!d->managedGroups.contains(ev.from)) {
+    if (!d->snapshot()->policy(ev.from).managed) {
         return false;
     }
 
@@ -35,7 +102,10 @@ bool AssistantModule::groupMessageEvent(const CoolQ::MessageEvent &ev)
 
     // 黑名单检查，如果发现匹配，直接踢出。
     if (d->blacklist->contains(ev.from, ev.sender)) {
-        kickGroupMember(ev.from, ev.sender, false);
+        d->blacklistHits.fetchAndAddRelaxed(1);
+        if (kickGroupMember(ev.from, ev.sender, false) == NoError) {
+            d->auditlog->addRecord(ev.from, ev.sender, currentId(), MemberAuditlog::Kick, 0, QString(u8"黑名单"));
+        }
         return true;
     }
 
@@ -92,6 +162,9 @@ bool AssistantModule::groupMessageEvent(const CoolQ::MessageEvent &ev)
 
 bool AssistantModule::discussMessageEvent(const CoolQ::MessageEvent &ev)
 {
+    Q_D(AssistantModule);
+    AssistantConfigReader reader(d);
+
     if (CoolQ::ServiceModule::discussMessageEvent(ev)) {
         return true;
     }
@@ -104,8 +177,9 @@ void AssistantModule::groupHelpAction(const CoolQ::MessageEvent &ev, const QStri
     Q_UNUSED(args);
 
     // 普通成员不应答。
+    const auto &policy = groupPolicy(ev.from);
     auto mi = memberInfo(ev.from, ev.sender, false);
-    if (mi.permission() < 2) {
+    if (mi.permission() < policy.orderPermission) {
         return;
     }
 
@@ -134,8 +208,9 @@ void AssistantModule::groupRenameAction(const CoolQ::MessageEvent &ev, const QSt
     Q_D(AssistantModule);
 
     // 普通成员不应答。
+    const auto &policy = groupPolicy(ev.from);
     auto mi = memberInfo(ev.from, ev.sender, false);
-    if (mi.permission() < 2) {
+    if (mi.permission() < policy.orderPermission) {
         return;
     }
 
@@ -197,7 +272,9 @@ void AssistantModule::groupRenameAction(const CoolQ::MessageEvent &ev, const QSt
 
     if (uids.isEmpty()) {
     } else {
-        renameGroupMember(ev.from, uids.at(0), nameCard);
+        if (renameGroupMember(ev.from, uids.at(0), nameCard) == NoError) {
+            d->auditlog->addRecord(ev.from, uids.at(0), ev.sender, MemberAuditlog::Rename, 0, nameCard);
+        }
     }
 
     showSuccess(ev.from, QString(u8"修改名片"), QString(u8"新的名片：%1").arg(nameCard));
@@ -208,8 +285,9 @@ void AssistantModule::groupFormatAction(const CoolQ::MessageEvent &ev, const QSt
     Q_D(AssistantModule);
 
     // 普通成员不应答。
+    const auto &policy = groupPolicy(ev.from);
     auto mi = memberInfo(ev.from, ev.sender, false);
-    if (mi.permission() < 2) {
+    if (mi.permission() < policy.orderPermission) {
         return;
     }
 
@@ -231,7 +309,7 @@ void AssistantModule::groupFormatAction(const CoolQ::MessageEvent &ev, const QSt
     for (auto uid : uids) {
         auto mi = memberInfo(ev.from, uid, false);
         if (mi.isValid()) {
-            if (mi.permission() == 1) {
+            if (mi.permission() <= policy.targetPermission) {
                 QString nameCard = mi.nameCard().remove(' ');
 
                 d->safetyNameCard(nameCard);
@@ -262,6 +340,7 @@ void AssistantModule::groupFormatAction(const CoolQ::MessageEvent &ev, const QSt
 
                 if (!nameCard.isEmpty() && (nameCard != mi.nameCard().trimmed())) {
                     if (renameGroupMember(ev.from, uid, nameCard) == NoError) {
+                        d->auditlog->addRecord(ev.from, uid, ev.sender, MemberAuditlog::Rename, 0, nameCard);
                         affectedIds.append(uid);
                     } else {
                         qDebug("RPC failed: %lld", uid);
@@ -283,8 +362,9 @@ void AssistantModule::groupBanAction(const CoolQ::MessageEvent &ev, const QStrin
     Q_D(AssistantModule);
 
     // 普通成员不应答。
+    const auto &policy = groupPolicy(ev.from);
     auto mi = memberInfo(ev.from, ev.sender, false);
-    if (mi.permission() < 2) {
+    if (mi.permission() < policy.orderPermission) {
         return;
     }
 
@@ -370,8 +450,9 @@ void AssistantModule::groupBanAction(const CoolQ::MessageEvent &ev, const QStrin
     for (auto uid : uids) {
         auto mi = memberInfo(ev.from, uid, false);
         if (mi.isValid()) {
-            if (mi.permission() == 1) {
+            if (mi.permission() <= policy.targetPermission) {
                 if (banGroupMember(ev.from, uid, duration) == NoError) {
+                    d->auditlog->addRecord(ev.from, uid, ev.sender, MemberAuditlog::Ban, duration);
                     affectedIds.append(uid);
                 } else {
                     qDebug("RPC failed: %lld", uid);
@@ -392,8 +473,9 @@ void AssistantModule::groupKickAction(const CoolQ::MessageEvent &ev, const QStri
     Q_D(AssistantModule);
 
     // 普通成员不应答。
+    const auto &policy = groupPolicy(ev.from);
     auto mi = memberInfo(ev.from, ev.sender, false);
-    if (mi.permission() < 2) {
+    if (mi.permission() < policy.orderPermission) {
         return;
     }
 
@@ -417,8 +499,9 @@ void AssistantModule::groupKickAction(const CoolQ::MessageEvent &ev, const QStri
     for (auto uid : uids) {
         auto mi = memberInfo(ev.from, uid, false);
         if (mi.isValid()) {
-            if (mi.permission() == 1) {
+            if (mi.permission() <= policy.targetPermission) {
                 if (kickGroupMember(ev.from, uid, false) == NoError) {
+                    d->auditlog->addRecord(ev.from, uid, ev.sender, MemberAuditlog::Kick);
                     affectedIds.append(uid);
                 } else {
                     qDebug("RPC failed: %lld", uid);
@@ -439,8 +522,9 @@ void AssistantModule::groupUnbanAction(const CoolQ::MessageEvent &ev, const QStr
     Q_D(AssistantModule);
 
     // 普通成员不应答。
+    const auto &policy = groupPolicy(ev.from);
     auto mi = memberInfo(ev.from, ev.sender, false);
-    if (mi.permission() < 2) {
+    if (mi.permission() < policy.orderPermission) {
         return;
     }
 
@@ -464,8 +548,9 @@ void AssistantModule::groupUnbanAction(const CoolQ::MessageEvent &ev, const QStr
     for (auto uid : uids) {
         auto mi = memberInfo(ev.from, uid, false);
         if (mi.isValid()) {
-            if (mi.permission() == 1) {
+            if (mi.permission() <= policy.targetPermission) {
                 if (banGroupMember(ev.from, uid, 0) == NoError) {
+                    d->auditlog->addRecord(ev.from, uid, ev.sender, MemberAuditlog::Unban);
                     affectedIds.append(uid);
                 } else {
                     qDebug("RPC failed: %lld", uid);
@@ -488,8 +573,9 @@ void AssistantModule::groupWatchlistAction(const CoolQ::MessageEvent &ev, const
     Q_D(AssistantModule);
 
     // 普通成员不应答。
+    const auto &policy = groupPolicy(ev.from);
     auto mi = memberInfo(ev.from, ev.sender, false);
-    if (mi.permission() < 2) {
+    if (mi.permission() < policy.orderPermission) {
         return;
     }
 
@@ -515,8 +601,9 @@ void AssistantModule::groupAddWatchlistAction(const CoolQ::MessageEvent &ev, con
     Q_D(AssistantModule);
 
     // 普通成员不应答。
+    const auto &policy = groupPolicy(ev.from);
     auto mi = memberInfo(ev.from, ev.sender, false);
-    if (mi.permission() < 2) {
+    if (mi.permission() < policy.orderPermission) {
         return;
     }
 
@@ -540,8 +627,10 @@ void AssistantModule::groupAddWatchlistAction(const CoolQ::MessageEvent &ev, con
     for (auto uid : uids) {
         auto mi = memberInfo(ev.from, uid, false);
         if (mi.isValid()) {
-            if (mi.permission() == 1) {
-                d->watchlist->addMember(ev.from, uid);
+            if (mi.permission() <= policy.targetPermission) {
+                if (d->watchlist->addMember(ev.from, uid) == CoolQ::SqliteService::Done) {
+                    d->auditlog->addRecord(ev.from, uid, ev.sender, MemberAuditlog::AddWatchlist);
+                }
                 affectedIds.append(uid);
             } else {
                 qDebug("Invalid permission: %lld", uid);
@@ -559,8 +648,9 @@ void AssistantModule::groupRemoveWatchlistAction(const CoolQ::MessageEvent &ev,
     Q_D(AssistantModule);
 
     // 普通成员不应答。
+    const auto &policy = groupPolicy(ev.from);
     auto mi = memberInfo(ev.from, ev.sender, false);
-    if (mi.permission() < 2) {
+    if (mi.permission() < policy.orderPermission) {
         return;
     }
 
@@ -579,8 +669,11 @@ void AssistantModule::groupRemoveWatchlistAction(const CoolQ::MessageEvent &ev,
 
     // 执行具体操作
 
-    for (auto uid : uids)
-        d->watchlist->removeMember(ev.from, uid);
+    for (auto uid : uids) {
+        if (d->watchlist->removeMember(ev.from, uid) == CoolQ::SqliteService::Done) {
+            d->auditlog->addRecord(ev.from, uid, ev.sender, MemberAuditlog::RemoveWatchlist);
+        }
+    }
 
     showSuccessList(ev.from, QString(u8"下列成员已移出观察室"), uids);
 }
@@ -592,8 +685,9 @@ void AssistantModule::groupBlacklistAction(const CoolQ::MessageEvent &ev, const
     Q_D(AssistantModule);
 
     // 普通成员不应答。
+    const auto &policy = groupPolicy(ev.from);
     auto mi = memberInfo(ev.from, ev.sender, false);
-    if (mi.permission() < 2) {
+    if (mi.permission() < policy.orderPermission) {
         return;
     }
 
@@ -619,8 +713,9 @@ void AssistantModule::groupAddBlacklistAction(const CoolQ::MessageEvent &ev, con
     Q_D(AssistantModule);
 
     // 普通成员不应答。
+    const auto &policy = groupPolicy(ev.from);
     auto mi = memberInfo(ev.from, ev.sender, false);
-    if (mi.permission() < 2) {
+    if (mi.permission() < policy.orderPermission) {
         return;
     }
 
@@ -644,8 +739,10 @@ void AssistantModule::groupAddBlacklistAction(const CoolQ::MessageEvent &ev, con
     for (auto uid : uids) {
         auto mi = memberInfo(ev.from, uid, false);
         if (mi.isValid()) {
-            if (mi.permission() == 1) {
-                d->blacklist->addMember(ev.from, uid);
+            if (mi.permission() <= policy.targetPermission) {
+                if (d->blacklist->addMember(ev.from, uid) == CoolQ::SqliteService::Done) {
+                    d->auditlog->addRecord(ev.from, uid, ev.sender, MemberAuditlog::AddBlacklist);
+                }
                 affectedIds.append(uid);
             } else {
                 qDebug("Invalid permission: %lld", uid);
@@ -663,8 +760,9 @@ void AssistantModule::groupRemoveBlacklistAction(const CoolQ::MessageEvent &ev,
     Q_D(AssistantModule);
 
     // 普通成员不应答。
+    const auto &policy = groupPolicy(ev.from);
     auto mi = memberInfo(ev.from, ev.sender, false);
-    if (mi.permission() < 2) {
+    if (mi.permission() < policy.orderPermission) {
         return;
     }
 
@@ -683,8 +781,11 @@ void AssistantModule::groupRemoveBlacklistAction(const CoolQ::MessageEvent &ev,
 
     // 执行具体操作
 
-    for (auto uid : uids)
-        d->blacklist->removeMember(ev.from, uid);
+    for (auto uid : uids) {
+        if (d->blacklist->removeMember(ev.from, uid) == CoolQ::SqliteService::Done) {
+            d->auditlog->addRecord(ev.from, uid, ev.sender, MemberAuditlog::RemoveBlacklist);
+        }
+    }
 
     showSuccessList(ev.from, QString(u8"下列成员已移出黑名单"), uids);
 }
@@ -743,134 +844,147 @@ void AssistantModule::groupMemberAction(const CoolQ::MessageEvent &ev, const QSt
     }
 }
 
-void AssistantModule::groupRenameHelpAction(qint64 gid)
+void AssistantModule::groupAuditlogAction(const CoolQ::MessageEvent &ev, const QStringList &args)
 {
-    QString usage;
-    QTextStream ts(&usage);
+    Q_D(AssistantModule);
 
-    ts << "<pre>";
-    ts << QString(u8"命令：<code>重命名 [@成员] 新的名片</code>\n");
-    ts << QString(u8"权限要求：") << "5+\n";
-    ts << "<code>  </code>" << QString(u8"如果不@其他成员，则重命名自己的名片。") << "\n";
-    ts << "</pre>";
+    // 普通成员不应答。
+    const auto &policy = groupPolicy(ev.from);
+    auto mi = memberInfo(ev.from, ev.sender, false);
+    if (mi.permission() < policy.orderPermission) {
+        return;
+    }
 
-    ts.flush();
+    // 默认显示最近 10 条，最多 50 条。
+    int count = 10;
+    if (!args.isEmpty()) {
+        count = qBound(1, args.at(0).toInt(), 50);
+    }
 
-    showPrompt(gid, QString(u8"重命名命令"), usage);
-}
+    auto records = d->auditlog->recentRecords(ev.from, count);
+    if (records.isEmpty()) {
+        showPrompt(ev.from, QString(u8"最近操作"), QString(u8"没有任何操作记录"));
+        return;
+    }
 
-void AssistantModule::groupFormatHelpAction(qint64 gid)
-{
-    QString usage;
-    QTextStream ts(&usage);
+    auto nameOf = [this, &ev](qint64 uid) -> QString {
+        if (uid == currentId())
+            return QString(u8"群助手");
+        CoolQ::MemberInfo mi = memberInfo(ev.from, uid);
+        if (mi.isValid())
+            return mi.nameCard().isEmpty() ? mi.nickName() : mi.nameCard();
+        return QString::number(uid);
+    };
 
-    ts << "<pre>";
-    ts << QString(u8"命令：<code>格式化 [@成员]</code>\n");
-    ts << QString(u8"权限要求：") << "5+\n";
-    ts << "<code>  </code>" << QString(u8"如果不@其他成员，则格式化自己的名片。") << "\n";
-    ts << "</pre>";
+    QStringList rows;
+    for (const auto &record : records) {
+        QString row;
+        QTextStream ts(&row);
 
-    ts.flush();
+        ts << "<code>" << QDateTime::fromMSecsSinceEpoch(record.stamp).toString("MM-dd hh:mm") << "</code> ";
+        ts << nameOf(record.actor).toHtmlEscaped() << ' ' << auditActionName(record.action)
+           << ' ' << nameOf(record.uid).toHtmlEscaped();
+        if (record.duration > 0) {
+            ts << "<span>(" << auditDuration(record.duration) << ")</span>";
+        } else if (!record.detail.isEmpty()) {
+            ts << "<span>(" << record.detail.toHtmlEscaped() << ")</span>";
+        }
+
+        ts.flush();
+        rows.append(row);
+    }
 
-    showPrompt(gid, QString(u8"格式化命令"), usage);
+    feedbackRows(ev.from, QString(u8"最近操作"), rows, HtmlDraw::Prompt);
 }
 
-void AssistantModule::groupBanHelpAction(qint64 gid)
+void AssistantModule::groupRenameHelpAction(qint64 gid)
 {
-    QString usage;
-    QTextStream ts(&usage);
+    // 帮助内容只生成一次，权限要求按群的策略填入。
+    static const QString usage = QString(u8"<pre>"
+        u8"命令：<code>重命名 [@成员] 新的名片</code>\n"
+        u8"权限要求：%1\n"
+        u8"<code>  </code>如果不@其他成员，则重命名自己的名片。\n"
+        u8"</pre>");
+
+    showPrompt(gid, QString(u8"重命名命令"), usage.arg(permissionName(groupPolicy(gid).orderPermission)));
+}
 
-    ts << "<pre>";
-    ts << QString(u8"命令：<code>禁言 @成员 @...</code>") << "\n";
-    ts << QString(u8"权限要求：") << "5+\n";
-    ts << QString(u8"参数列表：") << "\n";
-    ts << QString(u8"<code>  [1-30]d</code>：") << QString(u8"天数") << "\n";
-    ts << QString(u8"<code>  [1-24]h</code>：") << QString(u8"小时") << "\n";
-    ts << QString(u8"<code>  [1-60]m</code>：") << QString(u8"分钟") << "\n";
-    ts << "</pre>";
+void AssistantModule::groupFormatHelpAction(qint64 gid)
+{
+    static const QString usage = QString(u8"<pre>"
+        u8"命令：<code>格式化 [@成员]</code>\n"
+        u8"权限要求：%1\n"
+        u8"<code>  </code>如果不@其他成员，则格式化自己的名片。\n"
+        u8"</pre>");
 
-    ts.flush();
+    showPrompt(gid, QString(u8"格式化命令"), usage.arg(permissionName(groupPolicy(gid).orderPermission)));
+}
 
-    showPrompt(gid, QString(u8"禁言命令"), usage);
+void AssistantModule::groupBanHelpAction(qint64 gid)
+{
+    static const QString usage = QString(u8"<pre>"
+        u8"命令：<code>禁言 @成员 @...</code>\n"
+        u8"权限要求：%1\n"
+        u8"参数列表：\n"
+        u8"<code>  [1-30]d</code>：天数\n"
+        u8"<code>  [1-24]h</code>：小时\n"
+        u8"<code>  [1-60]m</code>：分钟\n"
+        u8"</pre>");
+
+    showPrompt(gid, QString(u8"禁言命令"), usage.arg(permissionName(groupPolicy(gid).orderPermission)));
 }
 
 void AssistantModule::groupKickHelpAction(qint64 gid)
 {
-    QString usage;
-    QTextStream ts(&usage);
+    static const QString usage = QString(u8"<pre>"
+        u8"命令：<code>踢出 @成员 @...</code>\n"
+        u8"权限要求：%1\n"
+        u8"</pre>");
 
-    ts << "<pre>";
-    ts << QString(u8"命令：<code>踢出 @成员 @...</code>") << "\n";
-    ts << QString(u8"权限要求：") << "3+\n";
-    ts << "</pre>";
-
-    ts.flush();
-
-    showPrompt(gid, QString(u8"踢出命令"), usage);
+    showPrompt(gid, QString(u8"踢出命令"), usage.arg(permissionName(groupPolicy(gid).orderPermission)));
 }
 
 void AssistantModule::groupUnbanHelpAction(qint64 gid)
 {
-    QString usage;
-    QTextStream ts(&usage);
-
-    ts << "<pre>";
-    ts << QString(u8"命令：<code>解禁 @成员 @...</code>") << "\n";
-    ts << QString(u8"权限要求：") << "5+\n";
-    ts << "</pre>";
+    static const QString usage = QString(u8"<pre>"
+        u8"命令：<code>解禁 @成员 @...</code>\n"
+        u8"权限要求：%1\n"
+        u8"</pre>");
 
-    ts.flush();
-
-    showPrompt(gid, QString(u8"解禁命令"), usage);
+    showPrompt(gid, QString(u8"解禁命令"), usage.arg(permissionName(groupPolicy(gid).orderPermission)));
 }
 
 void AssistantModule::groupWatchlistHelpAction(qint64 gid)
 {
-    QString usage;
-    QTextStream ts(&usage);
-
-    ts << "<pre>";
-    ts << QString(u8"命令：<code>观察室 [参数] [@成员 @...]</code>") << "\n";
-    ts << QString(u8"权限要求：") << "1+\n";
-    ts << QString(u8"参数列表：") << "\n";
-    ts << QString(u8"<code>  加入(+)</code>：") << QString(u8"加入观察") << "\n";
-    ts << "</pre>";
-
-    ts.flush();
-
-    showPrompt(gid, QString(u8"观察室用法"), usage);
+    static const QString usage = QString(u8"<pre>"
+        u8"命令：<code>观察室 [参数] [@成员 @...]</code>\n"
+        u8"权限要求：%1\n"
+        u8"参数列表：\n"
+        u8"<code>  加入(+)</code>：加入观察\n"
+        u8"</pre>");
+
+    showPrompt(gid, QString(u8"观察室用法"), usage.arg(permissionName(groupPolicy(gid).orderPermission)));
 }
 
 void AssistantModule::groupBlacklistHelpAction(qint64 gid)
 {
-    QString usage;
-    QTextStream ts(&usage);
-
-    ts << "<pre>";
-    ts << QString(u8"命令：<code>黑名单 [参数] [QQ号码 ...]</code>") << "\n";
-    ts << QString(u8"权限要求：") << "1+\n";
-    ts << QString(u8"参数列表：") << "\n";
-    ts << QString(u8"<code>  移出(-)</code>：") << QString(u8"移出名单") << "\n";
-    ts << "</pre>";
-
-    ts.flush();
-
-    showPrompt(gid, QString(u8"黑名单命令"), usage);
+    static const QString usage = QString(u8"<pre>"
+        u8"命令：<code>黑名单 [参数] [QQ号码 ...]</code>\n"
+        u8"权限要求：%1\n"
+        u8"参数列表：\n"
+        u8"<code>  移出(-)</code>：移出名单\n"
+        u8"</pre>");
+
+    showPrompt(gid, QString(u8"黑名单命令"), usage.arg(permissionName(groupPolicy(gid).orderPermission)));
 }
 
 
 void AssistantModule::groupMemberHelpAction(qint64 gid)
 {
-    QString usage;
-    QTextStream ts(&usage);
-
-    ts << "<pre>";
-    ts << QString(u8"命令：<code>成员信息 @成员</code>") << "\n";
-    ts << QString(u8"权限要求：") << "5+\n";
-    ts << "</pre>";
-
-    ts.flush();
+    static const QString usage = QString(u8"<pre>"
+        u8"命令：<code>成员信息 @成员</code>\n"
+        u8"权限要求：群主\n"
+        u8"</pre>");
 
     showPrompt(gid, QString(u8"成员信息命令"), usage);
 }
-
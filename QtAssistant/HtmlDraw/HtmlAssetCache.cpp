@@ -0,0 +1,221 @@
+﻿#include "HtmlAssetCache.h"
+#include "HtmlDraw_p.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QMetaEnum>
+#include <QSaveFile>
+#include <QDir>
+#include <QtDebug>
+
+namespace {
+
+const quint32 cacheMagic = 0x514d4143; // "QMAC"
+const quint32 cacheVersion = 1;
+
+// 映射的文件在最后一个引用它的 QImage 释放后才关闭。
+struct MappedFile
+{
+    QFile file;
+    QAtomicInt ref;
+};
+
+void releaseMappedFile(void *info)
+{
+    MappedFile *mapped = static_cast<MappedFile *>(info);
+    if (!mapped->ref.deref())
+        delete mapped;
+}
+
+qint64 alignOffset(qint64 offset)
+{
+    return (offset + 15) & ~qint64(15);
+}
+
+QVector<QImage *> themeImages(HtmlTheme *theme)
+{
+    QVector<QImage *> images;
+    for (int i = 0; i < HtmlTheme::StyleCount; ++i)
+        images.append(&theme->images[i]);
+    images.append(&theme->background);
+    images.append(&theme->foreground);
+    return images;
+}
+
+} // namespace
+
+QDataStream &operator<<(QDataStream &ds, const HtmlAssetEntry &entry)
+{
+    return ds << entry.name << entry.size << entry.modified;
+}
+
+QDataStream &operator>>(QDataStream &ds, HtmlAssetEntry &entry)
+{
+    return ds >> entry.name >> entry.size >> entry.modified;
+}
+
+// class HtmlAssetCache
+
+QVector<HtmlAssetEntry> HtmlAssetCache::manifest(const QString &path, const QString &defaultSheets)
+{
+    QStringList names;
+    auto styleEnum = QMetaEnum::fromType<HtmlDraw::Style>();
+    for (int i = 0; i < styleEnum.keyCount(); ++i) {
+        QString name = QString::fromLatin1(styleEnum.key(i));
+        names << name + ".css" << name + ".png";
+    }
+    names << "Background.png" << "Foreground.png";
+
+    // 缓存中保存的是合并后的样式表，默认样式变化时缓存同样失效。
+    HtmlAssetEntry defaults = { QString(), defaultSheets.size(), qHash(defaultSheets) };
+
+    QVector<HtmlAssetEntry> entries;
+    entries.append(defaults);
+
+    // 不存在的文件也要记录，新增素材时缓存才会失效。
+    for (const auto &name : names) {
+        QFileInfo fileInfo(path + '/' + name);
+        HtmlAssetEntry entry = { name, -1, -1 };
+        if (fileInfo.isFile()) {
+            entry.size = fileInfo.size();
+            entry.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+        }
+        entries.append(entry);
+    }
+
+    return entries;
+}
+
+bool HtmlAssetCache::load(const QString &fileName, const QVector<HtmlAssetEntry> &manifest, HtmlTheme *theme)
+{
+    MappedFile *mapped = new MappedFile();
+    mapped->ref.store(1);
+    mapped->file.setFileName(fileName);
+    if (!mapped->file.open(QFile::ReadOnly)) {
+        delete mapped;
+        return false;
+    }
+
+    QDataStream ds(&mapped->file);
+    ds.setVersion(QDataStream::Qt_5_9);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QVector<HtmlAssetEntry> entries;
+    ds >> magic >> version;
+    if (magic != cacheMagic || version != cacheVersion) {
+        delete mapped;
+        return false;
+    }
+
+    ds >> entries;
+    if (ds.status() != QDataStream::Ok || entries != manifest) {
+        delete mapped;
+        return false;
+    }
+
+    HtmlTheme cached;
+    for (int i = 0; i < HtmlTheme::StyleCount; ++i)
+        ds >> cached.sheets[i];
+
+    struct ImageHeader { qint32 width, height, bytesPerLine, format; qint64 offset; };
+    QVector<ImageHeader> headers;
+    for (int i = 0; i < HtmlTheme::StyleCount + 2; ++i) {
+        ImageHeader header;
+        ds >> header.width >> header.height >> header.bytesPerLine >> header.format >> header.offset;
+        headers.append(header);
+    }
+
+    if (ds.status() != QDataStream::Ok) {
+        delete mapped;
+        return false;
+    }
+
+    qint64 dataOffset = alignOffset(mapped->file.pos());
+    qint64 fileSize = mapped->file.size();
+
+    auto images = themeImages(&cached);
+    for (int i = 0; i < headers.count(); ++i) {
+        const ImageHeader &header = headers.at(i);
+        if (header.offset < 0)
+            continue;
+
+        qint64 size = qint64(header.bytesPerLine) * header.height;
+        if (dataOffset + header.offset + size > fileSize) {
+            releaseMappedFile(mapped);
+            return false;
+        }
+
+        uchar *bits = mapped->file.map(dataOffset + header.offset, size);
+        if (bits == nullptr) {
+            releaseMappedFile(mapped);
+            return false;
+        }
+
+        // 直接使用映射的内存，不需要解码；图片被修改时 QImage 会自动复制。
+        mapped->ref.ref();
+        *images.at(i) = QImage(const_cast<const uchar *>(bits), header.width, header.height,
+                               header.bytesPerLine, QImage::Format(header.format),
+                               releaseMappedFile, mapped);
+    }
+
+    releaseMappedFile(mapped);
+
+    *theme = cached;
+    return true;
+}
+
+bool HtmlAssetCache::save(const QString &fileName, const QVector<HtmlAssetEntry> &manifest, const HtmlTheme &theme)
+{
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+    HtmlTheme copy = theme;
+    auto images = themeImages(&copy);
+
+    QByteArray header;
+    QDataStream ds(&header, QIODevice::WriteOnly);
+    ds.setVersion(QDataStream::Qt_5_9);
+
+    ds << cacheMagic << cacheVersion << manifest;
+    for (int i = 0; i < HtmlTheme::StyleCount; ++i)
+        ds << copy.sheets[i];
+
+    qint64 offset = 0;
+    for (QImage *image : images) {
+        if (image->isNull()) {
+            ds << qint32(0) << qint32(0) << qint32(0) << qint32(0) << qint64(-1);
+            continue;
+        }
+
+        *image = image->convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        ds << qint32(image->width()) << qint32(image->height())
+           << qint32(image->bytesPerLine()) << qint32(image->format()) << offset;
+        offset = alignOffset(offset + qint64(image->bytesPerLine()) * image->height());
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    file.write(header);
+    file.write(QByteArray(int(alignOffset(header.size()) - header.size()), '\0'));
+
+    for (QImage *image : images) {
+        if (image->isNull())
+            continue;
+
+        qint64 size = qint64(image->bytesPerLine()) * image->height();
+        file.write(reinterpret_cast<const char *>(image->constBits()), size);
+        file.write(QByteArray(int(alignOffset(size) - size), '\0'));
+    }
+
+    // 旧的缓存文件仍被映射时无法替换，下次载入时再重试。
+    if (!file.commit()) {
+        qWarning() << "Save asset cache failed:" << fileName;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,30 @@
+﻿#ifndef HTMLASSETCACHE_H
+#define HTMLASSETCACHE_H
+
+#include <QString>
+#include <QVector>
+
+struct HtmlTheme;
+
+struct HtmlAssetEntry
+{
+    QString name;
+    qint64 size;
+    qint64 modified;
+};
+
+inline bool operator==(const HtmlAssetEntry &lhs, const HtmlAssetEntry &rhs)
+{
+    return lhs.name == rhs.name && lhs.size == rhs.size && lhs.modified == rhs.modified;
+}
+
+class HtmlAssetCache
+{
+public:
+    static QVector<HtmlAssetEntry> manifest(const QString &path, const QString &defaultSheets);
+
+    static bool load(const QString &fileName, const QVector<HtmlAssetEntry> &manifest, HtmlTheme *theme);
+    static bool save(const QString &fileName, const QVector<HtmlAssetEntry> &manifest, const HtmlTheme &theme);
+};
+
+#endif // HTMLASSETCACHE_H
@@ -0,0 +1,134 @@
+﻿#include "HtmlCache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+
+#include "HtmlTemplate.h"
+
+// class HtmlCache
+
+HtmlCache::HtmlCache(int maxCount)
+    : fileNames(maxCount)
+{
+}
+
+HtmlCache::~HtmlCache()
+{
+}
+
+QByteArray HtmlCache::key(const QString &html, HtmlDraw::Style style, int width, qint64 theme)
+{
+    QByteArray params;
+    do {
+        QDataStream ds(&params, QIODevice::WriteOnly);
+        ds << qint32(style) << qint32(width) << theme;
+    } while (false);
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(params);
+    hash.addData(reinterpret_cast<const char *>(html.constData()), html.size() * int(sizeof(QChar)));
+
+    return hash.result();
+}
+
+QByteArray HtmlCache::key(const HtmlTemplate &html, const QHash<QString, QString> &values,
+                          HtmlDraw::Style style, int width, qint64 theme)
+{
+    QByteArray params;
+    do {
+        QDataStream ds(&params, QIODevice::WriteOnly);
+        ds << qint32(style) << qint32(width) << theme;
+    } while (false);
+
+    // 静态部分已经预先算好摘要，这里只需要再哈希占位符的值。
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(params);
+    hash.addData(html.digest());
+    for (const auto &name : html.placeholders()) {
+        QString value = values.value(name);
+        qint32 size = value.size();
+        hash.addData(reinterpret_cast<const char *>(&size), int(sizeof(size)));
+        hash.addData(reinterpret_cast<const char *>(value.constData()), value.size() * int(sizeof(QChar)));
+    }
+
+    return hash.result();
+}
+
+QString HtmlCache::object(const QByteArray &key)
+{
+    QMutexLocker locker(&guard);
+
+    // QCache::object() 会把命中的条目移到最近使用的位置。
+    if (QString *fileName = fileNames.object(key)) {
+        hitCount.ref();
+        return *fileName;
+    }
+
+    missCount.ref();
+    return QString();
+}
+
+void HtmlCache::insert(const QByteArray &key, const QString &fileName)
+{
+    QMutexLocker locker(&guard);
+
+    if (!fileName.isEmpty())
+        fileNames.insert(key, new QString(fileName));
+}
+
+void HtmlCache::invalidate(const QByteArray &key)
+{
+    QMutexLocker locker(&guard);
+
+    // 文件已经不存在，上次的命中按未命中计算。
+    if (fileNames.remove(key)) {
+        hitCount.deref();
+        missCount.ref();
+    }
+}
+
+void HtmlCache::clear()
+{
+    QMutexLocker locker(&guard);
+
+    fileNames.clear();
+}
+
+int HtmlCache::maxCount() const
+{
+    QMutexLocker locker(&guard);
+
+    return fileNames.maxCost();
+}
+
+void HtmlCache::setMaxCount(int maxCount)
+{
+    QMutexLocker locker(&guard);
+
+    fileNames.setMaxCost(maxCount);
+}
+
+int HtmlCache::count() const
+{
+    QMutexLocker locker(&guard);
+
+    return fileNames.count();
+}
+
+int HtmlCache::hits() const
+{
+    return hitCount.load();
+}
+
+int HtmlCache::misses() const
+{
+    return missCount.load();
+}
+
+qreal HtmlCache::hitRate() const
+{
+    int h = hitCount.load();
+    int m = missCount.load();
+
+    return (h + m) > 0 ? qreal(h) / (h + m) : 0;
+}
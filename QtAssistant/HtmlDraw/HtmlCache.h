@@ -0,0 +1,48 @@
+﻿#ifndef HTMLCACHE_H
+#define HTMLCACHE_H
+
+#include <QAtomicInt>
+#include <QCache>
+#include <QMutex>
+
+#include "HtmlDraw.h"
+
+class HtmlTemplate;
+
+class HtmlCache
+{
+    Q_DISABLE_COPY(HtmlCache)
+
+public:
+    explicit HtmlCache(int maxCount = 256);
+    ~HtmlCache();
+
+public:
+    static QByteArray key(const QString &html, HtmlDraw::Style style, int width, qint64 theme);
+    static QByteArray key(const HtmlTemplate &html, const QHash<QString, QString> &values,
+                          HtmlDraw::Style style, int width, qint64 theme);
+
+public:
+    QString object(const QByteArray &key);
+    void insert(const QByteArray &key, const QString &fileName);
+    void invalidate(const QByteArray &key);
+    void clear();
+
+public:
+    int maxCount() const;
+    void setMaxCount(int maxCount);
+
+    int count() const;
+    int hits() const;
+    int misses() const;
+    qreal hitRate() const;
+
+private:
+    mutable QMutex guard;
+    QCache<QByteArray, QString> fileNames;
+
+    QAtomicInt hitCount;
+    QAtomicInt missCount;
+};
+
+#endif // HTMLCACHE_H
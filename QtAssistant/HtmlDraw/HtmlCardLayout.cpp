@@ -0,0 +1,522 @@
+﻿#include "HtmlCardLayout.h"
+
+#include <QPainter>
+#include <QRegularExpression>
+#include <QTextOption>
+
+namespace {
+
+// 与 QTextDocument 的默认值保持一致。
+const qreal documentMargin = 4;
+const qreal paragraphMargin = 12;
+
+QString unquote(const QString &value)
+{
+    QString result = value.trimmed();
+    if (result.size() >= 2 && (result.startsWith('"') || result.startsWith('\''))
+            && result.endsWith(result.at(0))) {
+        result = result.mid(1, result.size() - 2);
+    }
+    return result;
+}
+
+bool parseDecl(const QString &body, HtmlCssDecl *decl)
+{
+    for (const auto &item : body.split(';', QString::SkipEmptyParts)) {
+        int colon = item.indexOf(':');
+        if (colon < 0) {
+            if (item.trimmed().isEmpty())
+                continue;
+            return false;
+        }
+
+        QString name = item.left(colon).trimmed().toLower();
+        QString value = item.mid(colon + 1).trimmed();
+
+        bool ok = true;
+        if (name == "font-family") {
+            decl->family = unquote(value.section(',', 0, 0));
+        } else if (name == "font-size") {
+            decl->pixelSize = value.endsWith("px");
+            if (!decl->pixelSize && !value.endsWith("pt"))
+                return false;
+            decl->size = value.left(value.size() - 2).toDouble(&ok);
+        } else if (name == "color") {
+            decl->color = QColor(unquote(value));
+            ok = decl->color.isValid();
+        } else if (name == "line-height") {
+            if (!value.endsWith('%'))
+                return false;
+            decl->lineHeight = value.left(value.size() - 1).toDouble(&ok) / 100;
+        } else if (name == "font-weight") {
+            if (value == "bold") {
+                decl->weight = QFont::Bold;
+            } else if (value == "normal") {
+                decl->weight = QFont::Normal;
+            } else {
+                decl->weight = value.toInt(&ok) >= 600 ? QFont::Bold : QFont::Normal;
+            }
+        } else if (name == "font-style") {
+            decl->italic = (value == "italic" || value == "oblique") ? 1 : 0;
+        } else {
+            return false;
+        }
+
+        if (!ok)
+            return false;
+    }
+
+    return true;
+}
+
+bool parseParagraph(const QString &html, QString *paragraph)
+{
+    static const QString paragraphHead = QStringLiteral("<p class=\"c\">");
+    static const QString paragraphTail = QStringLiteral("</p>");
+
+    if (!html.startsWith(paragraphHead) || !html.endsWith(paragraphTail))
+        return false;
+
+    *paragraph = html.mid(paragraphHead.size(), html.size() - paragraphHead.size() - paragraphTail.size());
+    return !paragraph->contains("<p") && !paragraph->contains("<pre") && !paragraph->contains("<div");
+}
+
+// 名单卡片的表格：<tr> 中的每个 <td> 为空或者只包含一个段落。
+bool parseGrid(const QString &html, QVector<QStringList> *grid, int *columns)
+{
+    *columns = 0;
+    for (int i = 0; i < html.size();) {
+        if (!html.midRef(i).startsWith("<tr>"))
+            return false;
+
+        int rowEnd = html.indexOf("</tr>", i);
+        if (rowEnd < 0)
+            return false;
+
+        QStringList cells;
+        for (int j = i + 4; j < rowEnd;) {
+            if (!html.midRef(j).startsWith("<td"))
+                return false;
+
+            int s = html.indexOf('>', j) + 1;
+            int e = html.indexOf("</td>", j);
+            if (s <= 0 || e < s || e > rowEnd)
+                return false;
+
+            QString paragraph;
+            if (e > s && !parseParagraph(html.mid(s, e - s), &paragraph))
+                return false;
+
+            cells.append(paragraph);
+            j = e + 5;
+        }
+
+        *columns = qMax(*columns, cells.count());
+        grid->append(cells);
+        i = rowEnd + 5;
+    }
+
+    return *columns > 0;
+}
+
+HtmlCssDecl cascade(const HtmlCssDecl &inherited, const HtmlCssDecl &base, const HtmlCssDecl &own)
+{
+    HtmlCssDecl decl = inherited;
+    decl.merge(base);
+    decl.merge(own);
+    return decl;
+}
+
+} // namespace
+
+// struct HtmlCssDecl
+
+void HtmlCssDecl::merge(const HtmlCssDecl &other)
+{
+    if (!other.family.isEmpty())
+        family = other.family;
+    if (other.size > 0) {
+        size = other.size;
+        pixelSize = other.pixelSize;
+    }
+    if (other.weight >= 0)
+        weight = other.weight;
+    if (other.italic >= 0)
+        italic = other.italic;
+    if (other.color.isValid())
+        color = other.color;
+    if (other.lineHeight > 0)
+        lineHeight = other.lineHeight;
+}
+
+// struct HtmlCardStyle
+
+HtmlCardStyle HtmlCardStyle::fromSheet(const QString &sheet)
+{
+    HtmlCardStyle style;
+
+    QString css = sheet;
+    css.remove(QChar(0xfeff));
+    css.remove(QRegularExpression("/\\*.*?\\*/", QRegularExpression::DotMatchesEverythingOption));
+
+    int pos = 0;
+    forever {
+        int open = css.indexOf('{', pos);
+        if (open < 0)
+            break;
+
+        int close = css.indexOf('}', open);
+        if (close < 0)
+            return HtmlCardStyle();
+
+        HtmlCssDecl decl;
+        if (!parseDecl(css.mid(open + 1, close - open - 1), &decl))
+            return HtmlCardStyle();
+
+        // 只认识卡片模板用到的选择器。
+        for (const auto &selector : css.mid(pos, open - pos).split(',')) {
+            QString name = selector.trimmed();
+            if (name == "*") {
+                style.base.merge(decl);
+            } else if (name == ".t") {
+                style.title.merge(decl);
+            } else if (name == ".c") {
+                style.content.merge(decl);
+            } else if (name == "code") {
+                style.code.merge(decl);
+            } else if (name == ".warning") {
+                style.warning.merge(decl);
+            } else {
+                return HtmlCardStyle();
+            }
+        }
+
+        pos = close + 1;
+    }
+
+    if (!css.mid(pos).trimmed().isEmpty())
+        return HtmlCardStyle();
+
+    style.valid = true;
+    return style;
+}
+
+// class HtmlCardLayout
+
+HtmlCardLayout::HtmlCardLayout()
+    : totalHeight(0)
+    , lastMargin(0)
+{
+}
+
+HtmlCardLayout::~HtmlCardLayout()
+{
+    qDeleteAll(layouts);
+}
+
+bool HtmlCardLayout::setContent(const QString &html, const HtmlCardStyle &style, qreal textWidth)
+{
+    if (!style.valid)
+        return false;
+
+    // 只处理 feedback、feedbackRows 和 feedbackGrid 生成的模板，其他内容交给 QTextDocument。
+    static const QString head = QStringLiteral("<html><body><span class=\"t\">");
+    static const QString tail = QStringLiteral("</body></html>");
+    static const QString paragraphHead = QStringLiteral("<p class=\"c\">");
+    static const QString paragraphTail = QStringLiteral("</p>");
+
+    if (!html.startsWith(head) || !html.endsWith(tail))
+        return false;
+
+    int titleEnd = html.indexOf("</span>", head.size());
+    if (titleEnd < 0)
+        return false;
+
+    QString title = html.mid(head.size(), titleEnd - head.size());
+    if (title.contains('<'))
+        return false;
+
+    QString rest = html.mid(titleEnd + 7, html.size() - titleEnd - 7 - tail.size());
+    QStringList paragraphs;
+    QVector<QStringList> grid;
+    int columns = 0;
+    if (rest.startsWith("<table") && rest.endsWith("</table>")) {
+        int s = rest.indexOf('>') + 1;
+        if (!parseGrid(rest.mid(s, rest.size() - s - 8), &grid, &columns))
+            return false;
+        rest.clear();
+    } else if (rest.startsWith("<div>") && rest.endsWith("</div>")) {
+        rest = rest.mid(5, rest.size() - 11);
+    }
+
+    for (int i = 0; i < rest.size();) {
+        if (!rest.midRef(i).startsWith(paragraphHead))
+            return false;
+
+        int e = rest.indexOf(paragraphTail, i + paragraphHead.size());
+        if (e < 0)
+            return false;
+
+        QString paragraph;
+        if (!parseParagraph(rest.mid(i, e + paragraphTail.size() - i), &paragraph))
+            return false;
+
+        paragraphs.append(paragraph);
+        i = e + paragraphTail.size();
+    }
+
+    // 标题和段落直接位于文档根下，根本身没有声明，只继承通用的 base。
+    HtmlCssDecl titleDecl = cascade(HtmlCssDecl(), style.base, style.title);
+    if (!addBlock(title, style, titleDecl, 0, textWidth))
+        return false;
+
+    HtmlCssDecl contentDecl = cascade(HtmlCssDecl(), style.base, style.content);
+    for (const auto &paragraph : paragraphs) {
+        if (!addBlock(paragraph, style, contentDecl, paragraphMargin, textWidth))
+            return false;
+    }
+
+    for (const auto &cells : grid) {
+        if (!addRow(cells, columns, style, contentDecl, paragraphMargin, textWidth))
+            return false;
+    }
+
+    totalHeight += lastMargin + documentMargin;
+    return true;
+}
+
+qreal HtmlCardLayout::height() const
+{
+    return totalHeight;
+}
+
+void HtmlCardLayout::draw(QPainter *painter, const QPointF &pos) const
+{
+    for (auto layout : layouts)
+        layout->draw(painter, pos);
+}
+
+bool HtmlCardLayout::addBlock(const QString &html, const HtmlCardStyle &style, const HtmlCssDecl &decl,
+                              qreal margin, qreal textWidth)
+{
+    beginBlock(margin);
+
+    qreal height = 0;
+    auto layout = layoutText(html, style, decl, textWidth - documentMargin * 2, &height);
+    if (!layout)
+        return false;
+
+    layout->setPosition(QPointF(documentMargin, totalHeight));
+    totalHeight += height;
+
+    return true;
+}
+
+bool HtmlCardLayout::addRow(const QStringList &cells, int columns, const HtmlCardStyle &style,
+                            const HtmlCssDecl &decl, qreal margin, qreal textWidth)
+{
+    beginBlock(margin);
+
+    // 各列等宽，行高取最高的单元格。
+    qreal columnWidth = (textWidth - documentMargin * 2) / columns;
+    qreal rowHeight = 0;
+    for (int i = 0; i < cells.count(); ++i) {
+        if (cells.at(i).isEmpty())
+            continue;
+
+        qreal height = 0;
+        auto layout = layoutText(cells.at(i), style, decl, columnWidth, &height);
+        if (!layout)
+            return false;
+
+        layout->setPosition(QPointF(documentMargin + columnWidth * i, totalHeight));
+        rowHeight = qMax(rowHeight, height);
+    }
+
+    totalHeight += rowHeight;
+    return true;
+}
+
+void HtmlCardLayout::beginBlock(qreal margin)
+{
+    // 相邻段落的外边距合并，与 QTextDocument 的排版一致。
+    if (totalHeight == 0)
+        totalHeight = documentMargin;
+    totalHeight += qMax(lastMargin, margin);
+    lastMargin = margin;
+}
+
+QTextLayout *HtmlCardLayout::layoutText(const QString &html, const HtmlCardStyle &style, const HtmlCssDecl &decl,
+                                        qreal lineWidth, qreal *height)
+{
+    QString text;
+    QVector<QTextLayout::FormatRange> formats;
+    if (!parseInline(html, style, decl, &text, &formats))
+        return nullptr;
+
+    QTextOption option;
+    option.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+    option.setUseDesignMetrics(true);
+
+    auto layout = new QTextLayout(text, font(decl));
+    layout->setTextOption(option);
+    layout->setFormats(formats);
+    layout->setCacheEnabled(true);
+    layouts.append(layout);
+
+    qreal lineHeight = decl.lineHeight > 0 ? decl.lineHeight : 1;
+    qreal y = 0;
+
+    layout->beginLayout();
+    forever {
+        QTextLine line = layout->createLine();
+        if (!line.isValid())
+            break;
+
+        line.setLineWidth(lineWidth);
+        line.setPosition(QPointF(0, y));
+        y += line.height() * lineHeight;
+    }
+    layout->endLayout();
+
+    *height = y;
+    return layout;
+}
+
+bool HtmlCardLayout::parseInline(const QString &html, const HtmlCardStyle &style, const HtmlCssDecl &decl,
+                                 QString *text, QVector<QTextLayout::FormatRange> *formats)
+{
+    QVector<HtmlCssDecl> stack;
+    stack.append(decl);
+
+    bool pendingSpace = false;
+    bool formatChanged = true;
+
+    auto appendChar = [&](QChar ch) {
+        if (formatChanged || formats->isEmpty()) {
+            QTextLayout::FormatRange range;
+            range.start = text->size();
+            range.length = 0;
+            range.format = charFormat(stack.last());
+            formats->append(range);
+            formatChanged = false;
+        }
+
+        text->append(ch);
+        formats->last().length++;
+    };
+
+    auto append = [&](QChar ch) {
+        if (pendingSpace) {
+            pendingSpace = false;
+            if (!text->isEmpty() && text->at(text->size() - 1) != QChar::LineSeparator)
+                appendChar(QChar(' '));
+        }
+
+        appendChar(ch);
+    };
+
+    for (int i = 0; i < html.size(); ++i) {
+        QChar ch = html.at(i);
+
+        if (ch == '<') {
+            int e = html.indexOf('>', i);
+            if (e < 0)
+                return false;
+
+            QString tag = html.mid(i + 1, e - i - 1).trimmed();
+            i = e;
+
+            if (tag == "br" || tag == "br/" || tag == "br /") {
+                pendingSpace = false;
+                append(QChar::LineSeparator);
+            } else if (tag == "code") {
+                stack.append(cascade(stack.last(), style.base, style.code));
+                formatChanged = true;
+            } else if (tag == "span") {
+                stack.append(cascade(stack.last(), style.base, HtmlCssDecl()));
+                formatChanged = true;
+            } else if (tag == "span class=\"warning\"" || tag == "span class='warning'") {
+                stack.append(cascade(stack.last(), style.base, style.warning));
+                formatChanged = true;
+            } else if (tag == "/code" || tag == "/span") {
+                if (stack.count() < 2)
+                    return false;
+                stack.removeLast();
+                formatChanged = true;
+            } else {
+                return false;
+            }
+            continue;
+        }
+
+        if (ch == '&') {
+            int e = html.indexOf(';', i);
+            if (e > i && e - i <= 8) {
+                QString entity = html.mid(i + 1, e - i - 1);
+                QChar decoded;
+                if (entity == "lt") {
+                    decoded = '<';
+                } else if (entity == "gt") {
+                    decoded = '>';
+                } else if (entity == "amp") {
+                    decoded = '&';
+                } else if (entity == "quot") {
+                    decoded = '"';
+                } else if (entity == "apos") {
+                    decoded = '\'';
+                } else if (entity == "nbsp") {
+                    decoded = QChar::Nbsp;
+                } else if (entity.startsWith("#x")) {
+                    decoded = QChar(entity.mid(2).toUShort(nullptr, 16));
+                } else if (entity.startsWith('#')) {
+                    decoded = QChar(entity.mid(1).toUShort());
+                }
+
+                if (!decoded.isNull()) {
+                    append(decoded);
+                    i = e;
+                    continue;
+                }
+            }
+        }
+
+        // 与 HTML 相同，连续的空白折叠为一个空格。
+        if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
+            pendingSpace = true;
+            continue;
+        }
+
+        append(ch);
+    }
+
+    return stack.count() == 1;
+}
+
+QTextCharFormat HtmlCardLayout::charFormat(const HtmlCssDecl &decl)
+{
+    QTextCharFormat format;
+    format.setFont(font(decl));
+    if (decl.color.isValid())
+        format.setForeground(decl.color);
+    return format;
+}
+
+QFont HtmlCardLayout::font(const HtmlCssDecl &decl)
+{
+    QFont font;
+    if (!decl.family.isEmpty())
+        font.setFamily(decl.family);
+    if (decl.size > 0) {
+        if (decl.pixelSize) {
+            font.setPixelSize(qRound(decl.size));
+        } else {
+            font.setPointSizeF(decl.size);
+        }
+    }
+    if (decl.weight >= 0)
+        font.setWeight(decl.weight);
+    if (decl.italic >= 0)
+        font.setItalic(decl.italic != 0);
+    return font;
+}
@@ -0,0 +1,72 @@
+﻿#ifndef HTMLCARDLAYOUT_H
+#define HTMLCARDLAYOUT_H
+
+#include <QColor>
+#include <QStringList>
+#include <QTextLayout>
+#include <QVector>
+
+class QPainter;
+
+struct HtmlCssDecl
+{
+    QString family;
+    qreal size = -1;
+    bool pixelSize = false;
+    int weight = -1;
+    int italic = -1;
+    QColor color;
+    qreal lineHeight = -1;
+
+    void merge(const HtmlCssDecl &other);
+};
+
+struct HtmlCardStyle
+{
+    // 样式表中出现无法识别的选择器或属性时为 false，卡片回退到 QTextDocument。
+    bool valid = false;
+
+    HtmlCssDecl base;
+    HtmlCssDecl title;
+    HtmlCssDecl content;
+    HtmlCssDecl code;
+    HtmlCssDecl warning;
+
+    static HtmlCardStyle fromSheet(const QString &sheet);
+};
+
+class HtmlCardLayout
+{
+    Q_DISABLE_COPY(HtmlCardLayout)
+
+public:
+    HtmlCardLayout();
+    ~HtmlCardLayout();
+
+public:
+    bool setContent(const QString &html, const HtmlCardStyle &style, qreal textWidth);
+
+    qreal height() const;
+    void draw(QPainter *painter, const QPointF &pos) const;
+
+private:
+    bool addBlock(const QString &html, const HtmlCardStyle &style, const HtmlCssDecl &decl,
+                  qreal margin, qreal textWidth);
+    bool addRow(const QStringList &cells, int columns, const HtmlCardStyle &style, const HtmlCssDecl &decl,
+                qreal margin, qreal textWidth);
+    void beginBlock(qreal margin);
+    QTextLayout *layoutText(const QString &html, const HtmlCardStyle &style, const HtmlCssDecl &decl,
+                            qreal lineWidth, qreal *height);
+
+    static bool parseInline(const QString &html, const HtmlCardStyle &style, const HtmlCssDecl &decl,
+                            QString *text, QVector<QTextLayout::FormatRange> *formats);
+    static QTextCharFormat charFormat(const HtmlCssDecl &decl);
+    static QFont font(const HtmlCssDecl &decl);
+
+private:
+    QVector<QTextLayout *> layouts;
+    qreal totalHeight;
+    qreal lastMargin;
+};
+
+#endif // HTMLCARDLAYOUT_H
@@ -1,10 +1,20 @@
 ﻿#include "HtmlDraw.h"
 #include "HtmlDraw_p.h"
-
+#include "HtmlAssetCache.h"
+#include "HtmlCardLayout.h"
+#include "HtmlQuantizer.h"
+
+#include <QtConcurrentRun>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QThread>
 #include <QTextDocument>
 #include <QPainter>
+#include <QtMath>
 #include <QFile>
-#include <QDir>
+#include <QFileInfo>
+#include <QMetaEnum>
+#include <QSharedPointer>
 #include <QtDebug>
 
 // class HtmlDraw
@@ -15,42 +25,168 @@ HtmlDraw::HtmlDraw(const QString &path, QObject *parent)
 {
     d_ptr->q_ptr = this;
 
-    d_ptr->updateMaterialData(path);
+    d_ptr->materialPath = path;
 }
 
 HtmlDraw::~HtmlDraw()
 {
 }
 
-QPixmap HtmlDraw::drawText(const QString &text, Style style, int width, qint64 theme)
+QString HtmlDraw::materialPath() const
+{
+    Q_D(const HtmlDraw);
+
+    return d->materialPath;
+}
+
+void HtmlDraw::updateMaterials()
+{
+    Q_D(HtmlDraw);
+
+    d->updateMaterialData();
+}
+
+int HtmlDraw::workerCount() const
+{
+    Q_D(const HtmlDraw);
+
+    return d->workers.maxThreadCount();
+}
+
+void HtmlDraw::setWorkerCount(int workerCount)
 {
-    if (nullptr != HtmlDrawPrivate::instance)
-        return HtmlDrawPrivate::instance->drawText(text, style, width, theme);
+    Q_D(HtmlDraw);
+
+    if (workerCount <= 0)
+        workerCount = QThread::idealThreadCount();
 
-    return QPixmap();
+    workerCount = qMax(1, workerCount);
+    int oldCount = d->workers.maxThreadCount();
+    if (workerCount == oldCount)
+        return;
+
+    d->workers.setMaxThreadCount(workerCount);
+
+    // 已经预热过时，线程数增加后补上新线程的预热，不等待其他线程，不影响正在进行的渲染。
+    if (d->warmUpStarted.load() && workerCount > oldCount)
+        d->startWarmUp(true);
 }
 
-QPixmap HtmlDraw::drawPrimaryText(const QString &text, int width, qint64 theme)
+HtmlDraw::LayoutMetrics HtmlDraw::layoutMetrics() const
+{
+    Q_D(const HtmlDraw);
+
+    QMutexLocker locker(&d->metricsGuard);
+    return d->layoutMetrics;
+}
+
+// 在每个工作线程中预先渲染一遍常用字符，应在设置好线程数之后调用。
+void HtmlDraw::warmUp()
+{
+    Q_D(HtmlDraw);
+
+    d->startWarmUp(false);
+}
+
+int HtmlDraw::warmUpTime() const
+{
+    Q_D(const HtmlDraw);
+
+    return d->warmUpTime.load();
+}
+
+int HtmlDraw::maxThemeCount() const
+{
+    Q_D(const HtmlDraw);
+
+    QMutexLocker locker(&d->cacheGuard);
+    return d->themes.maxCost();
+}
+
+void HtmlDraw::setMaxThemeCount(int maxThemeCount)
+{
+    Q_D(HtmlDraw);
+
+    QMutexLocker locker(&d->cacheGuard);
+    d->themes.setMaxCost(qMax(1, maxThemeCount));
+}
+
+int HtmlDraw::paletteSize() const
+{
+    Q_D(const HtmlDraw);
+
+    return d->paletteSize.load();
+}
+
+void HtmlDraw::setPaletteSize(int paletteSize)
+{
+    Q_D(HtmlDraw);
+
+    d->paletteSize.store(paletteSize > 0 ? qBound(2, paletteSize, 256) : 0);
+}
+
+bool HtmlDraw::isDithering() const
+{
+    Q_D(const HtmlDraw);
+
+    return d->dithering.load() != 0;
+}
+
+void HtmlDraw::setDithering(bool dithering)
+{
+    Q_D(HtmlDraw);
+
+    d->dithering.store(dithering ? 1 : 0);
+}
+
+// 返回群组 theme 实际使用的主题编号，没有定制素材时为 0，渲染结果只取决于这个编号。
+qint64 HtmlDraw::themeId(qint64 theme)
+{
+    HtmlDrawPrivate *d = HtmlDrawPrivate::instance;
+    return (nullptr != d) ? d->theme(theme).id : theme;
+}
+
+QImage HtmlDraw::drawText(const QString &text, Style style, int width, qint64 theme)
+{
+    return drawTextAsync(text, style, width, theme).result();
+}
+
+QFuture<QImage> HtmlDraw::drawTextAsync(const QString &text, Style style, int width, qint64 theme)
+{
+    HtmlDrawPrivate *d = HtmlDrawPrivate::instance;
+    if (nullptr != d) {
+        return QtConcurrent::run(&d->workers, [d, text, style, width, theme]() {
+            return d->renderText(text, style, width, theme);
+        });
+    }
+
+    QImage image;
+    QFutureInterface<QImage> fi(QFutureInterfaceBase::Started);
+    fi.reportFinished(&image);
+    return fi.future();
+}
+
+QImage HtmlDraw::drawPrimaryText(const QString &text, int width, qint64 theme)
 {
     return drawText(text, HtmlDraw::Primary, width, theme);
 }
 
-QPixmap HtmlDraw::drawDangerText(const QString &text, int width, qint64 theme)
+QImage HtmlDraw::drawDangerText(const QString &text, int width, qint64 theme)
 {
     return drawText(text, HtmlDraw::Danger, width, theme);
 }
 
-QPixmap HtmlDraw::drawWarningText(const QString &text, int width, qint64 theme)
+QImage HtmlDraw::drawWarningText(const QString &text, int width, qint64 theme)
 {
     return drawText(text, HtmlDraw::Warning, width, theme);
 }
 
-QPixmap HtmlDraw::drawPromptText(const QString &text, int width, qint64 theme)
+QImage HtmlDraw::drawPromptText(const QString &text, int width, qint64 theme)
 {
     return drawText(text, HtmlDraw::Prompt, width, theme);
 }
 
-QPixmap HtmlDraw::drawSuccessText(const QString &text, int width, qint64 theme)
+QImage HtmlDraw::drawSuccessText(const QString &text, int width, qint64 theme)
 {
     return drawText(text, HtmlDraw::Success, width, theme);
 }
@@ -61,164 +197,403 @@ HtmlDrawPrivate *HtmlDrawPrivate::instance = nullptr;
 
 HtmlDrawPrivate::HtmlDrawPrivate()
     : q_ptr(Q_NULLPTR)
+    , themes(32)
+    , generation(0)
+    , chromes(16 * 1024)
+    , warmUpStarted(0)
+    , warmUpTime(-1)
 {
     Q_CHECK_PTR(nullptr == HtmlDrawPrivate::instance);
     HtmlDrawPrivate::instance = this;
 
-    primarySheet = readCssFile(":/HtmlDraw/css/Primary.css");
-    dangerSheet = readCssFile(":/HtmlDraw/css/Danger.css");
-    warningSheet = readCssFile(":/HtmlDraw/css/Warning.css");
-    promptSheet = readCssFile(":/HtmlDraw/css/Prompt.css");
-    successSheet = readCssFile(":/HtmlDraw/css/Success.css");
-
-    backgroundImage.load(":/HtmlDraw/img/Background.png");
-    foregroundImage.load(":/HtmlDraw/img/Foreground.png");
+    defaultFont = QGuiApplication::font();
+    workers.setExpiryTimeout(-1);
+
+    layoutMetrics.pooledCount = 0;
+    layoutMetrics.pooledTime = 0;
+    layoutMetrics.freshCount = 0;
+    layoutMetrics.freshTime = 0;
+    layoutMetrics.fastCount = 0;
+    layoutMetrics.fastTime = 0;
+
+    auto styleEnum = QMetaEnum::fromType<HtmlDraw::Style>();
+    for (int i = 0; i < styleEnum.keyCount(); ++i) {
+        int style = styleEnum.value(i);
+        QString name = QString::fromLatin1(styleEnum.key(i));
+
+        defaultTheme.sheets[style] = readCssFile(":/HtmlDraw/css/" + name + ".css");
+        defaultTheme.images[style].load(":/HtmlDraw/img/" + name + ".png");
+        defaultTheme.cardStyles[style] = HtmlCardStyle::fromSheet(defaultTheme.sheets[style]);
+        defaultSheets += defaultTheme.sheets[style];
+    }
 
-    primaryImage.load(":/HtmlDraw/img/Primary.png");
-    dangerImage.load(":/HtmlDraw/img/Danger.png");
-    warningImage.load(":/HtmlDraw/img/Warning.png");
-    promptImage.load(":/HtmlDraw/img/Prompt.png");
-    successImage.load(":/HtmlDraw/img/Success.png");
+    defaultTheme.background.load(":/HtmlDraw/img/Background.png");
+    defaultTheme.foreground.load(":/HtmlDraw/img/Foreground.png");
 }
 
 HtmlDrawPrivate::~HtmlDrawPrivate()
 {
     HtmlDrawPrivate::instance = nullptr;
+    workers.waitForDone();
 }
 
-void HtmlDrawPrivate::updateMaterialData(const QString &path)
+void HtmlDrawPrivate::startWarmUp(bool reload)
 {
-    for (auto fileInfo : QDir(path).entryInfoList(QDir::Dirs)) {
-        qint64  key = fileInfo.fileName().toLongLong();
-        QString filePath = fileInfo.absoluteFilePath();
+    QSharedPointer<HtmlWarmUp> run(new HtmlWarmUp());
+    run->threads = workers.maxThreadCount();
+    run->reload = reload;
+    run->timer.start();
+    run->arrived.store(0);
+    run->pending.store(run->threads);
 
-        QString primarySheetTemp = readCssFile(filePath + "/Primary.css");
-        QString dangerSheetTemp = readCssFile(filePath + "/Danger.css");
-        QString warningSheetTemp = readCssFile(filePath + "/Warning.css");
-        QString promptSheetTemp = readCssFile(filePath + "/Prompt.css");
-        QString successSheetTemp = readCssFile(filePath + "/Success.css");
+    warmUpStarted.store(1);
 
-        QPixmap backgroundImageTemp(filePath + "/Background.png");
-        QPixmap foregroundImageTemp(filePath + "/Foreground.png");
+    for (int i = 0; i < run->threads; ++i)
+        QtConcurrent::run(&workers, [this, run]() { warmUp(run.data()); });
+}
 
-        QPixmap primaryImageTemp(filePath + "/Primary.png");
-        QPixmap dangerImageTemp(filePath + "/Danger.png");
-        QPixmap warningImageTemp(filePath + "/Warning.png");
-        QPixmap promptImageTemp(filePath + "/Prompt.png");
-        QPixmap successImageTemp(filePath + "/Success.png");
+void HtmlDrawPrivate::warmUp(HtmlWarmUp *run)
+{
+    // 字体缓存和字形缓存是每个线程各自的，首次预热时等所有任务都分到各自的线程后再开始。
+    // 重新预热时不等待，任务落在已经预热过的线程上就直接结束，空出线程给其他任务。
+    bool warmed = warmedThreads.hasLocalData();
+    if (!run->reload) {
+        run->arrived.ref();
+        QElapsedTimer waiting;
+        waiting.start();
+        while (run->arrived.load() < run->threads && waiting.elapsed() < 1000)
+            QThread::msleep(1);
+    }
 
-        if (!primarySheetTemp.isEmpty())
-            primarySheets.insert(key, primarySheet + "\n\n" + primarySheetTemp);
-        if (!dangerSheetTemp.isEmpty())
-            dangerSheets.insert(key, dangerSheet + "\n\n" + dangerSheetTemp);
-        if (!warningSheetTemp.isEmpty())
-            warningSheets.insert(key, warningSheet + "\n\n" + warningSheetTemp);
-        if (!promptSheetTemp.isEmpty())
-            promptSheets.insert(key, promptSheet + "\n\n" + promptSheetTemp);
-        if (!successSheetTemp.isEmpty())
-            successSheets.insert(key, successSheet + "\n\n" + successSheetTemp);
+    // 常用汉字、数字、标点和帮助卡片中的文字。
+    static const QString corpus = QString(u8"的一是不了人我在有他这中大来上个国到说们为子和你地出道也时年得就"
+                                          u8"那要下以生会自着去之过家学对可她里后小么心多天而能好都然没日于起还"
+                                          u8"发成事只作当想看文无开手十用主行方又如前所本见经头面公同三已老从动"
+                                          u8"两长知民样现分将外但身些与高意进把法此实回二理美点月明其种声全工己"
+                                          u8"群成员名片禁言踢出解禁观察室黑名单重命名格式化权限要求参数列表命令"
+                                          u8"天数小时分钟加入移出不在本群所在地欢迎新人最近操作部分第"
+                                          u8"0123456789 ABCDEFGHIJKLMNOPQRSTUVWXYZ abcdefghijklmnopqrstuvwxyz"
+                                          u8"，。！？：；、（）【】《》“”‘’…—～ ,.!?:;()[]<>'\"-+*/=@#%&_");
+
+    static const QString card = QString("<html><body><span class=\"t\">%1</span><p class=\"c\">%2</p></body></html>")
+            .arg(corpus.left(8), corpus.toHtmlEscaped());
+    static const QString help = QString("<html><body><span class=\"t\">%1</span><p class=\"c\">"
+                                        "<pre><code>%2</code>\n%2</pre></p></body></html>")
+            .arg(corpus.left(8), corpus.toHtmlEscaped());
+
+    // 两种排版路径都走一遍：卡片模板用 QTextLayout，帮助卡片用 QTextDocument。
+    // 预热的渲染不计入排版统计。
+    if (!warmed) {
+        for (int style = 0; style < HtmlTheme::StyleCount; ++style) {
+            drawText(card, HtmlDraw::Style(style), 400, 0, false);
+            drawText(help, HtmlDraw::Style(style), 400, 0, false);
+        }
+        warmedThreads.setLocalData(true);
+    }
 
-        if (!backgroundImageTemp.isNull())
-            backgroundImages.insert(key, backgroundImageTemp);
-        if (!foregroundImageTemp.isNull())
-            foregroundImages.insert(key, foregroundImageTemp);
+    if (!run->pending.deref()) {
+        int msecs = int(run->timer.elapsed());
+        if (!run->reload)
+            warmUpTime.store(msecs);
+        qInfo("HtmlDraw warm-up: %d ms on %d threads.", msecs, run->threads);
+    }
+}
+
+void HtmlDrawPrivate::updateMaterialData()
+{
+    QMutexLocker locker(&cacheGuard);
+
+    // 重新载入时，被删除的素材应恢复为默认素材。
+    ++generation;
+    themes.clear();
+    chromes.clear();
+}
+
+HtmlTheme HtmlDrawPrivate::theme(qint64 gid) const
+{
+    int loadGeneration = 0;
+
+    do {
+        QMutexLocker locker(&cacheGuard);
+        if (HtmlTheme *cached = themes.object(gid))
+            return *cached;
+        loadGeneration = generation;
+    } while (false);
+
+    HtmlTheme *loaded = new HtmlTheme(loadTheme(gid));
+    HtmlTheme result = *loaded;
+
+    QMutexLocker locker(&cacheGuard);
+    if (loadGeneration == generation) {
+        themes.insert(gid, loaded);
+    } else {
+        delete loaded;
+    }
+
+    return result;
+}
+
+HtmlTheme HtmlDrawPrivate::loadTheme(qint64 gid) const
+{
+    // 主题 0 使用素材目录本身，其他主题使用以群号命名的子目录。
+    QString path = materialPath;
+    if (gid != 0)
+        path += '/' + QString::number(gid);
+
+    if (!QFileInfo(path).isDir())
+        return defaultTheme;
+
+    // 解码后的素材保存在素材目录旁的缓存文件中，源文件的大小和修改时间不变时直接映射使用。
+    QString cacheName = QString("%1.cache/%2.cache").arg(materialPath).arg(gid);
+    auto manifest = HtmlAssetCache::manifest(path, defaultSheets);
+
+    HtmlTheme overrides;
+    if (!HtmlAssetCache::load(cacheName, manifest, &overrides)) {
+        overrides = decodeTheme(path);
+        HtmlAssetCache::save(cacheName, manifest, overrides);
+    }
+
+    HtmlTheme theme = defaultTheme;
+    for (int i = 0; i < HtmlTheme::StyleCount; ++i) {
+        if (!overrides.sheets[i].isEmpty()) {
+            theme.sheets[i] = overrides.sheets[i];
+            theme.cardStyles[i] = HtmlCardStyle::fromSheet(theme.sheets[i]);
+        }
+        if (!overrides.images[i].isNull())
+            theme.images[i] = overrides.images[i];
+    }
+
+    if (!overrides.background.isNull())
+        theme.background = overrides.background;
+    if (!overrides.foreground.isNull())
+        theme.foreground = overrides.foreground;
 
-        if (!primaryImageTemp.isNull())
-            primaryImages.insert(key, primaryImageTemp);
-        if (!dangerImageTemp.isNull())
-            dangerImages.insert(key, dangerImageTemp);
-        if (!warningImageTemp.isNull())
-            warningImages.insert(key, warningImageTemp);
-        if (!promptImageTemp.isNull())
-            promptImages.insert(key, promptImageTemp);
-        if (!successImageTemp.isNull())
-            successImages.insert(key, successImageTemp);
+    theme.id = gid;
+    return theme;
+}
+
+HtmlTheme HtmlDrawPrivate::decodeTheme(const QString &path) const
+{
+    // 只包含被定制的素材，其余成员为空。
+    HtmlTheme theme;
+
+    auto styleEnum = QMetaEnum::fromType<HtmlDraw::Style>();
+    for (int i = 0; i < styleEnum.keyCount(); ++i) {
+        int style = styleEnum.value(i);
+        QString name = QString::fromLatin1(styleEnum.key(i));
+
+        QString sheet = readCssFile(path + '/' + name + ".css");
+        if (!sheet.isEmpty())
+            theme.sheets[style] = defaultTheme.sheets[style] + "\n\n" + sheet;
+
+        QImage image(path + '/' + name + ".png");
+        if (!image.isNull())
+            theme.images[style] = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
     }
+
+    QImage background(path + "/Background.png");
+    if (!background.isNull())
+        theme.background = background.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    QImage foreground(path + "/Foreground.png");
+    if (!foreground.isNull())
+        theme.foreground = foreground.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    return theme;
 }
 
-QPixmap HtmlDrawPrivate::drawText(const QString &text, HtmlDraw::Style style, int width, qint64 theme) const
+QImage HtmlDrawPrivate::drawText(const QString &text, HtmlDraw::Style style, int width, qint64 theme,
+                                 bool measured) const
 {
-    QPixmap source;
+    int themeGeneration = 0;
+    do {
+        QMutexLocker locker(&cacheGuard);
+        themeGeneration = generation;
+    } while (false);
+
+    HtmlTheme assets = this->theme(theme);
 
     qreal contentMargins = 20;
     qreal bw = 12;
     qreal cm = contentMargins;
 
-    QTextDocument htmlDoc;
-    htmlDoc.setUndoRedoEnabled(false);
-    htmlDoc.setUseDesignMetrics(true);
-    htmlDoc.setTextWidth(width - bw - cm * 2);
-    switch (style) {
-    case HtmlDraw::Primary:
-        htmlDoc.setDefaultStyleSheet(primarySheets.value(theme, primarySheet));
-        source = primaryImages.value(theme, primaryImage);
-        break;
-    case HtmlDraw::Danger:
-        htmlDoc.setDefaultStyleSheet(dangerSheets.value(theme, dangerSheet));
-        source = dangerImages.value(theme, dangerImage);
-        break;
-    case HtmlDraw::Warning:
-        htmlDoc.setDefaultStyleSheet(warningSheets.value(theme, warningSheet));
-        source = warningImages.value(theme, warningImage);
-        break;
-    case HtmlDraw::Prompt:
-        htmlDoc.setDefaultStyleSheet(promptSheets.value(theme, promptSheet));
-        source = promptImages.value(theme, promptImage);
-        break;
-    case HtmlDraw::Success:
-        htmlDoc.setDefaultStyleSheet(successSheets.value(theme, successSheet));
-        source = successImages.value(theme, successImage);
-        break;
-    }
-    htmlDoc.setHtml(text);
-
-    QSizeF size = htmlDoc.size();
-    QPixmap target(width, size.height() + cm * 2);
-    target.fill(Qt::transparent);
+    QElapsedTimer timer;
+    timer.start();
+
+    qreal textWidth = width - bw - cm * 2;
+    qreal height = 0;
+
+    // 固定模板的卡片直接用 QTextLayout 排版，跳过 HTML 解析和富文本排版。
+    HtmlCardLayout card;
+    bool fast = card.setContent(text, assets.cardStyles[style], textWidth);
+
+    bool pooled = false;
+    QTextDocument *htmlDoc = nullptr;
+    if (fast) {
+        height = card.height() + cm * 2;
+    } else {
+        HtmlDocumentKey docKey = { style, assets.id, width, themeGeneration };
+        htmlDoc = document(docKey, assets.sheets[style], &pooled);
+        htmlDoc->setTextWidth(textWidth);
+        htmlDoc->setHtml(text);
+        height = htmlDoc->size().height() + cm * 2;
+    }
+
+    // 分别统计各排版路径的耗时（微秒），用于比较文档池和快速路径的效果。
+    qint64 layoutTime = timer.nsecsElapsed() / 1000;
+    if (measured) {
+        QMutexLocker locker(&metricsGuard);
+        if (fast) {
+            layoutMetrics.fastCount++;
+            layoutMetrics.fastTime += layoutTime;
+        } else if (pooled) {
+            layoutMetrics.pooledCount++;
+            layoutMetrics.pooledTime += layoutTime;
+        } else {
+            layoutMetrics.freshCount++;
+            layoutMetrics.freshTime += layoutTime;
+        }
+    }
+
+    // 高度按 16 像素分档，同一档位的卡片共用合成好的背景和边框。
+    int th = (qCeil(height) + 15) / 16 * 16;
+
+    HtmlChromeKey key = { style, assets.id, width, th };
+    HtmlChrome layers = chrome(assets, key, themeGeneration);
+
+    // 复制背景层，只在上面绘制文字。
+    QImage target = layers.background;
 
     QPainter painter(&target);
     painter.setRenderHint(QPainter::Antialiasing);
+
+    painter.translate(bw + cm, cm + (th - height) / 2);
+    if (fast) {
+        card.draw(&painter, QPointF(0, 0));
+    } else {
+        htmlDoc->drawContents(&painter);
+    }
+    painter.resetTransform();
+
+    if (!layers.foreground.isNull()) {
+        painter.drawImage(0, 0, layers.foreground);
+    }
+
+    return target;
+}
+
+QImage HtmlDrawPrivate::renderText(const QString &text, HtmlDraw::Style style, int width, qint64 theme) const
+{
+    QImage image = drawText(text, style, width, theme);
+
+    // 卡片以纯色文字为主，量化为 8 位调色板可以大幅缩小编码后的文件。
+    int colors = paletteSize.load();
+    if (colors > 0)
+        image = HtmlQuantizer::quantize(image, colors, dithering.load() != 0);
+
+    return image;
+}
+
+HtmlChrome HtmlDrawPrivate::chrome(const HtmlTheme &theme, const HtmlChromeKey &key, int generation) const
+{
+    do {
+        QMutexLocker locker(&cacheGuard);
+        if (HtmlChrome *layers = chromes.object(key))
+            return *layers;
+    } while (false);
+
+    int width = key.width;
+    int height = key.height;
+
+    const QImage &source = theme.images[key.style];
+    const QImage &bgImage = theme.background;
+    const QImage &fgImage = theme.foreground;
+
+    // 纹理偏移由图层参数决定，相同的卡片总是得到相同的图片，才能被缓存。
+    uint seed = qHash(key);
+
+    HtmlChrome *layers = new HtmlChrome();
+    layers->background = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
+    layers->background.fill(Qt::transparent);
+
+    QPainter painter(&layers->background);
+    painter.setRenderHint(QPainter::Antialiasing);
     painter.setRenderHint(QPainter::SmoothPixmapTransform);
 
-    int tw = target.width();
-    int th = target.height();
+    int tw = width;
+    int th = height;
     int sw = source.width();
     int sh = source.height();
 
     // Background
 
-    QPixmap bgImage = backgroundImages.value(theme, backgroundImage);
+    // 平铺纹理只填充可见区域，不再绘制九倍面积。
     if (!bgImage.isNull()) {
         painter.save();
-        painter.translate(qrand() % 10, qrand() % 10);
-        painter.drawTiledPixmap(-tw, -th, tw * 3, th * 3, bgImage);
+        painter.setBrushOrigin(seed % 10, (seed / 10) % 10);
+        painter.fillRect(0, 0, tw, th, QBrush(bgImage));
         painter.restore();
     }
 
     if (!source.isNull()) {
-        painter.drawPixmap(0, 0, 40, 40, source, 0, 0, 40, 40);
-        painter.drawPixmap(40, 0, tw - 80, 40, source, 40, 0, sw - 80, 40);
-        painter.drawPixmap(tw - 40, 0, 40, 40, source, sw - 40, 0, 40, 40);
-        painter.drawPixmap(tw - 40, 40, 40, th - 80, source, sw - 40, 40, 40, sh - 80);
-        painter.drawPixmap(tw - 40, th - 40, 40, 40, source, sw - 40, sh - 40, 40, 40);
-        painter.drawPixmap(40, th - 40, tw - 80, 40, source, 40, sh - 40, sw - 80, 40);
-        painter.drawPixmap(0, th - 40, 40, 40, source, 0, sh - 40, 40, 40);
-        painter.drawPixmap(0, 40, 40, th - 80, source, 0, 40, 40, sh - 80);
-        painter.drawPixmap(40, 40, tw - 80, th - 80, source, 40, 40, sw - 80, sh - 80);
+        painter.drawImage(QRect(0, 0, 40, 40), source, QRect(0, 0, 40, 40));
+        painter.drawImage(QRect(40, 0, tw - 80, 40), source, QRect(40, 0, sw - 80, 40));
+        painter.drawImage(QRect(tw - 40, 0, 40, 40), source, QRect(sw - 40, 0, 40, 40));
+        painter.drawImage(QRect(tw - 40, 40, 40, th - 80), source, QRect(sw - 40, 40, 40, sh - 80));
+        painter.drawImage(QRect(tw - 40, th - 40, 40, 40), source, QRect(sw - 40, sh - 40, 40, 40));
+        painter.drawImage(QRect(40, th - 40, tw - 80, 40), source, QRect(40, sh - 40, sw - 80, 40));
+        painter.drawImage(QRect(0, th - 40, 40, 40), source, QRect(0, sh - 40, 40, 40));
+        painter.drawImage(QRect(0, 40, 40, th - 80), source, QRect(0, 40, 40, sh - 80));
+        painter.drawImage(QRect(40, 40, tw - 80, th - 80), source, QRect(40, 40, sw - 80, sh - 80));
     }
 
-    painter.translate(bw + cm, cm);
-    htmlDoc.drawContents(&painter);
+    painter.end();
+
+    // Foreground
 
-    QPixmap fgImage = foregroundImages.value(theme, foregroundImage);
     if (!fgImage.isNull()) {
-        painter.save();
-        painter.translate(qrand() % 10, qrand() % 10);
-        painter.drawTiledPixmap(-tw, -th, tw * 3, th * 3, fgImage);
-        painter.restore();
+        layers->foreground = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
+        layers->foreground.fill(Qt::transparent);
+
+        QPainter fgPainter(&layers->foreground);
+        fgPainter.setBrushOrigin((seed / 100) % 10, (seed / 1000) % 10);
+        fgPainter.fillRect(0, 0, tw, th, QBrush(fgImage));
     }
 
-    return target;
+    HtmlChrome result = *layers;
+
+    int cost = (layers->background.byteCount() + layers->foreground.byteCount()) / 1024;
+    QMutexLocker locker(&cacheGuard);
+    if (generation == this->generation) {
+        chromes.insert(key, layers, qMax(1, cost));
+    } else {
+        delete layers;
+    }
+
+    return result;
+}
+
+QTextDocument *HtmlDrawPrivate::document(const HtmlDocumentKey &key, const QString &sheet, bool *pooled) const
+{
+    if (!documents.hasLocalData())
+        documents.setLocalData(new QCache<HtmlDocumentKey, QTextDocument>(16));
+
+    auto pool = documents.localData();
+    if (QTextDocument *htmlDoc = pool->object(key)) {
+        *pooled = true;
+        return htmlDoc;
+    }
+
+    // 素材重新载入后 generation 改变，旧的文档不再命中，逐渐被淘汰。
+    auto htmlDoc = new QTextDocument();
+    htmlDoc->setUndoRedoEnabled(false);
+    htmlDoc->setUseDesignMetrics(true);
+    htmlDoc->setDefaultFont(defaultFont);
+    htmlDoc->setDefaultStyleSheet(sheet);
+    pool->insert(key, htmlDoc);
+
+    *pooled = false;
+    return htmlDoc;
 }
 
 QString HtmlDrawPrivate::readCssFile(const QString &fileName)
@@ -2,6 +2,8 @@
 #define HTMLDRAW_H
 
 #include <QObject>
+#include <QFuture>
+#include <QImage>
 
 class HtmlDrawPrivate;
 class HtmlDraw : public QObject
@@ -16,7 +18,34 @@ protected:
 public:
     virtual ~HtmlDraw();
 
+public:
+    QString materialPath() const;
+    void updateMaterials();
+
+    int workerCount() const;
+    void setWorkerCount(int workerCount);
+
+    int maxThemeCount() const;
+    void setMaxThemeCount(int maxThemeCount);
+
+    int paletteSize() const;
+    void setPaletteSize(int paletteSize);
+    bool isDithering() const;
+    void setDithering(bool dithering);
+
+public:
+    struct LayoutMetrics {
+        int pooledCount;
+        qint64 pooledTime;
+        int freshCount;
+        qint64 freshTime;
+        int fastCount;
+        qint64 fastTime;
+    };
 
+    LayoutMetrics layoutMetrics() const;
+    void warmUp();
+    int warmUpTime() const;
 
 public:
     enum Style {
@@ -29,14 +58,16 @@ public:
     Q_ENUM(Style)
 
 public:
-    static QPixmap drawText(const QString &text, Style style, int width = 400, qint64 theme = 0);
+    static qint64 themeId(qint64 theme);
+    static QImage drawText(const QString &text, Style style, int width = 400, qint64 theme = 0);
+    static QFuture<QImage> drawTextAsync(const QString &text, Style style, int width = 400, qint64 theme = 0);
 
 public:
-    static QPixmap drawPrimaryText(const QString &text, int width = 400, qint64 theme = 0);
-    static QPixmap drawDangerText(const QString &text, int width = 400, qint64 theme = 0);
-    static QPixmap drawWarningText(const QString &text, int width = 400, qint64 theme = 0);
-    static QPixmap drawPromptText(const QString &text, int width = 400, qint64 theme = 0);
-    static QPixmap drawSuccessText(const QString &text, int width = 400, qint64 theme = 0);
+    static QImage drawPrimaryText(const QString &text, int width = 400, qint64 theme = 0);
+    static QImage drawDangerText(const QString &text, int width = 400, qint64 theme = 0);
+    static QImage drawWarningText(const QString &text, int width = 400, qint64 theme = 0);
+    static QImage drawPromptText(const QString &text, int width = 400, qint64 theme = 0);
+    static QImage drawSuccessText(const QString &text, int width = 400, qint64 theme = 0);
 
 
 };
@@ -1,11 +1,22 @@
+QT *= concurrent
 INCLUDEPATH += $$PWD
 
 HEADERS += \
+    $$PWD/HtmlAssetCache.h \
+    $$PWD/HtmlCache.h \
+    $$PWD/HtmlCardLayout.h \
     $$PWD/HtmlDraw.h \
-    $$PWD/HtmlDraw_p.h
+    $$PWD/HtmlDraw_p.h \
+    $$PWD/HtmlQuantizer.h \
+    $$PWD/HtmlTemplate.h
 
 SOURCES += \
-    $$PWD/HtmlDraw.cpp
+    $$PWD/HtmlAssetCache.cpp \
+    $$PWD/HtmlCache.cpp \
+    $$PWD/HtmlCardLayout.cpp \
+    $$PWD/HtmlDraw.cpp \
+    $$PWD/HtmlQuantizer.cpp \
+    $$PWD/HtmlTemplate.cpp
 
 RESOURCES += \
     $$PWD/HtmlDraw.qrc
@@ -1,10 +1,90 @@
 ﻿#ifndef HTMLDRAW_P_H
 #define HTMLDRAW_P_H
 
+#include <QAtomicInt>
+#include <QCache>
+#include <QElapsedTimer>
+#include <QFont>
 #include <QHash>
-#include <QPixmap>
+#include <QImage>
+#include <QMutex>
+#include <QThreadPool>
+#include <QThreadStorage>
+#include "HtmlCardLayout.h"
 #include "HtmlDraw.h"
 
+class QTextDocument;
+
+struct HtmlTheme
+{
+    enum { StyleCount = HtmlDraw::Success + 1 };
+
+    // 各成员都是隐式共享的，未定制的素材与默认主题共用同一份数据。
+    QString sheets[StyleCount];
+    QImage images[StyleCount];
+    QImage background;
+    QImage foreground;
+
+    // 从样式表中解析出的字体和颜色，供 HtmlCardLayout 使用。
+    HtmlCardStyle cardStyles[StyleCount];
+
+    // 实际生效的主题编号，没有定制素材的群组与默认主题一样为 0，文档池和背景缓存按它区分。
+    qint64 id = 0;
+};
+
+struct HtmlChromeKey
+{
+    HtmlDraw::Style style;
+    qint64 theme;
+    int width;
+    int height;
+};
+
+inline bool operator==(const HtmlChromeKey &lhs, const HtmlChromeKey &rhs)
+{
+    return lhs.style == rhs.style && lhs.theme == rhs.theme
+            && lhs.width == rhs.width && lhs.height == rhs.height;
+}
+
+inline uint qHash(const HtmlChromeKey &key, uint seed = 0)
+{
+    return ::qHash(key.theme, seed) ^ (uint(key.style) << 28) ^ (uint(key.width) << 16) ^ uint(key.height);
+}
+
+struct HtmlDocumentKey
+{
+    HtmlDraw::Style style;
+    qint64 theme;
+    int width;
+    int generation;
+};
+
+inline bool operator==(const HtmlDocumentKey &lhs, const HtmlDocumentKey &rhs)
+{
+    return lhs.style == rhs.style && lhs.theme == rhs.theme
+            && lhs.width == rhs.width && lhs.generation == rhs.generation;
+}
+
+inline uint qHash(const HtmlDocumentKey &key, uint seed = 0)
+{
+    return ::qHash(key.theme, seed) ^ (uint(key.style) << 28) ^ (uint(key.width) << 16) ^ uint(key.generation);
+}
+
+struct HtmlChrome
+{
+    QImage background;
+    QImage foreground;
+};
+
+struct HtmlWarmUp
+{
+    QElapsedTimer timer;
+    QAtomicInt arrived;
+    QAtomicInt pending;
+    int threads;
+    bool reload;
+};
+
 class HtmlDrawPrivate
 {
     Q_DECLARE_PUBLIC(HtmlDraw)
@@ -19,48 +99,60 @@ public:
     static HtmlDrawPrivate *instance;
 
 public:
-    void updateMaterialData(const QString &path);
-    QPixmap drawText(const QString &text, HtmlDraw::Style style,
-                     int width, qint64 theme = 0) const;
-    QString readCssFile(const QString &fileName);
-
-private:
-    QString primarySheet;
-    QString dangerSheet;
-    QString warningSheet;
-    QString promptSheet;
-    QString successSheet;
-
-private:
-    QPixmap backgroundImage;
-    QPixmap foregroundImage;
-
-private:
-    QPixmap primaryImage;
-    QPixmap dangerImage;
-    QPixmap warningImage;
-    QPixmap promptImage;
-    QPixmap successImage;
-
-private:
-    QHash<qint64, QString> primarySheets;
-    QHash<qint64, QString> dangerSheets;
-    QHash<qint64, QString> warningSheets;
-    QHash<qint64, QString> promptSheets;
-    QHash<qint64, QString> successSheets;
-
-private:
-    QHash<qint64, QPixmap> backgroundImages;
-    QHash<qint64, QPixmap> foregroundImages;
-
-private:
-    QHash<qint64, QPixmap> primaryImages;
-    QHash<qint64, QPixmap> dangerImages;
-    QHash<qint64, QPixmap> warningImages;
-    QHash<qint64, QPixmap> promptImages;
-    QHash<qint64, QPixmap> successImages;
+    void updateMaterialData();
+    HtmlTheme theme(qint64 gid) const;
+    HtmlTheme loadTheme(qint64 gid) const;
+    HtmlTheme decodeTheme(const QString &path) const;
+
+    QImage drawText(const QString &text, HtmlDraw::Style style,
+                    int width, qint64 theme = 0, bool measured = true) const;
+    QImage renderText(const QString &text, HtmlDraw::Style style,
+                      int width, qint64 theme = 0) const;
+    static QString readCssFile(const QString &fileName);
+
+    QTextDocument *document(const HtmlDocumentKey &key, const QString &sheet, bool *pooled) const;
+    HtmlChrome chrome(const HtmlTheme &theme, const HtmlChromeKey &key, int generation) const;
+
+    void startWarmUp(bool reload);
+    void warmUp(HtmlWarmUp *run);
+
+public:
+    QString materialPath;
+    HtmlTheme defaultTheme;
+    QString defaultSheets;
+
+    // 主题按需载入，只保留最近使用的若干个；素材重新载入时 generation 加一，
+    // 旧版本素材合成的结果不会再被放入缓存。
+    mutable QMutex cacheGuard;
+    mutable QCache<qint64, HtmlTheme> themes;
+    int generation;
+
+public:
+    // 渲染只在工作线程中进行，每个工作线程持有自己的文档池和字体。
+    // 文档按 (样式, 主题, 宽度) 预先设置好样式表，复用时只替换内容，不再重复解析 CSS。
+    // workers 声明在最后，最先析构，工作线程退出时由 documents 释放各自的文档。
+    QFont defaultFont;
+    mutable QThreadStorage<QCache<HtmlDocumentKey, QTextDocument> *> documents;
+
+    // 背景纹理和边框按 (样式, 主题, 宽度, 高度档位) 合成一次，之后只需复制。
+    mutable QCache<HtmlChromeKey, HtmlChrome> chromes;
+    mutable QThreadPool workers;
+
+public:
+    // 调色板大小为 0 时不做量化，保持 32 位输出。
+    QAtomicInt paletteSize;
+    QAtomicInt dithering;
+
+public:
+    // 预热在每个工作线程中渲染一遍常用字符，完成前 warmUpTime 为 -1。
+    // 线程数增加后只预热新的线程，已经预热过的线程直接跳过，每一轮使用各自的计数。
+    QAtomicInt warmUpStarted;
+    QAtomicInt warmUpTime;
+    QThreadStorage<bool> warmedThreads;
 
 public:
+    mutable QMutex metricsGuard;
+    mutable HtmlDraw::LayoutMetrics layoutMetrics;
 
 };
 
@@ -0,0 +1,244 @@
+﻿#include "HtmlQuantizer.h"
+
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+struct ColorCount
+{
+    QRgb color;
+    int count;
+};
+
+struct ColorBox
+{
+    int begin;
+    int end;
+    int count;
+    int shift;
+    int range;
+};
+
+// 按 a, r, g, b 顺序取通道时的位移。
+const int channelShifts[4] = { 24, 16, 8, 0 };
+
+ColorBox measureBox(const QVector<ColorCount> &colors, int begin, int end)
+{
+    int lower[4] = { 255, 255, 255, 255 };
+    int upper[4] = { 0, 0, 0, 0 };
+
+    ColorBox box = { begin, end, 0, 0, 0 };
+    for (int i = begin; i < end; ++i) {
+        const ColorCount &cc = colors.at(i);
+        for (int ch = 0; ch < 4; ++ch) {
+            int v = (cc.color >> channelShifts[ch]) & 0xff;
+            lower[ch] = qMin(lower[ch], v);
+            upper[ch] = qMax(upper[ch], v);
+        }
+        box.count += cc.count;
+    }
+
+    for (int ch = 0; ch < 4; ++ch) {
+        if (upper[ch] - lower[ch] > box.range) {
+            box.range = upper[ch] - lower[ch];
+            box.shift = channelShifts[ch];
+        }
+    }
+
+    return box;
+}
+
+} // namespace
+
+// class HtmlQuantizer
+
+QImage HtmlQuantizer::quantize(const QImage &image, int maxColors, bool dithering)
+{
+    if (image.isNull())
+        return image;
+
+    maxColors = qBound(2, maxColors, 256);
+
+    // 调色板中的颜色不预乘透明度。
+    QImage source = image.convertToFormat(QImage::Format_ARGB32);
+    int w = source.width();
+    int h = source.height();
+
+    QHash<QRgb, int> indexes;
+    QVector<QRgb> palette = medianCut(source, maxColors, indexes);
+
+    QImage target(w, h, QImage::Format_Indexed8);
+    target.setColorTable(palette);
+
+    if (!dithering) {
+        // 每种颜色只查找一次，相邻的同色像素直接复用上一次的结果。
+        QRgb lastColor = 0;
+        int lastIndex = -1;
+        for (int y = 0; y < h; ++y) {
+            const QRgb *src = reinterpret_cast<const QRgb *>(source.constScanLine(y));
+            uchar *dst = target.scanLine(y);
+            for (int x = 0; x < w; ++x) {
+                if (lastIndex < 0 || src[x] != lastColor) {
+                    lastColor = src[x];
+                    lastIndex = indexes.value(lastColor);
+                }
+                dst[x] = uchar(lastIndex);
+            }
+        }
+        return target;
+    }
+
+    // Floyd-Steinberg 抖动。误差扩散后的颜色通过 20 位的查找表映射到调色板。
+    QVector<qint16> lookup(1 << 20, -1);
+    QVector<int> errors(4 * (w + 2), 0);
+    QVector<int> nextErrors(4 * (w + 2), 0);
+
+    for (int y = 0; y < h; ++y) {
+        const QRgb *src = reinterpret_cast<const QRgb *>(source.constScanLine(y));
+        uchar *dst = target.scanLine(y);
+        nextErrors.fill(0);
+
+        for (int x = 0; x < w; ++x) {
+            int *err = errors.data() + 4 * (x + 1);
+
+            int v[4];
+            for (int ch = 0; ch < 4; ++ch) {
+                int c = (src[x] >> channelShifts[ch]) & 0xff;
+                v[ch] = qBound(0, c + err[ch] / 16, 255);
+            }
+
+            int key = ((v[0] >> 3) << 15) | ((v[1] >> 3) << 10) | ((v[2] >> 3) << 5) | (v[3] >> 3);
+            int index = lookup.at(key);
+            if (index < 0) {
+                index = nearestColor(palette, v[0], v[1], v[2], v[3]);
+                lookup[key] = qint16(index);
+            }
+            dst[x] = uchar(index);
+
+            QRgb p = palette.at(index);
+            int *right = err + 4;
+            int *below = nextErrors.data() + 4 * (x + 1);
+            for (int ch = 0; ch < 4; ++ch) {
+                int e = v[ch] - int((p >> channelShifts[ch]) & 0xff);
+                right[ch] += e * 7;
+                below[ch - 4] += e * 3;
+                below[ch] += e * 5;
+                below[ch + 4] += e;
+            }
+        }
+
+        errors.swap(nextErrors);
+    }
+
+    return target;
+}
+
+QVector<QRgb> HtmlQuantizer::medianCut(const QImage &image, int maxColors, QHash<QRgb, int> &indexes)
+{
+    QHash<QRgb, int> histogram;
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); ++x)
+            ++histogram[line[x]];
+    }
+
+    QVector<ColorCount> colors;
+    colors.reserve(histogram.count());
+    for (auto it = histogram.constBegin(); it != histogram.constEnd(); ++it) {
+        ColorCount cc = { it.key(), it.value() };
+        colors.append(cc);
+    }
+
+    QVector<QRgb> palette;
+
+    // 颜色本来就不多时，直接使用原始颜色。
+    if (colors.count() <= maxColors) {
+        for (const ColorCount &cc : colors) {
+            indexes.insert(cc.color, palette.count());
+            palette.append(cc.color);
+        }
+        return palette;
+    }
+
+    QVector<ColorBox> boxes;
+    boxes.append(measureBox(colors, 0, colors.count()));
+
+    while (boxes.count() < maxColors) {
+        // 优先切分像素多且颜色跨度大的盒子。
+        int target = -1;
+        qint64 priority = 0;
+        for (int i = 0; i < boxes.count(); ++i) {
+            const ColorBox &box = boxes.at(i);
+            qint64 p = qint64(box.range) * box.count;
+            if (box.end - box.begin > 1 && p > priority) {
+                priority = p;
+                target = i;
+            }
+        }
+
+        if (target < 0)
+            break;
+
+        ColorBox box = boxes.at(target);
+        int shift = box.shift;
+        std::sort(colors.begin() + box.begin, colors.begin() + box.end,
+                  [shift](const ColorCount &lhs, const ColorCount &rhs) {
+            return ((lhs.color >> shift) & 0xff) < ((rhs.color >> shift) & 0xff);
+        });
+
+        int half = box.count / 2;
+        int split = box.begin + 1;
+        for (int sum = 0, i = box.begin; i < box.end - 1; ++i) {
+            sum += colors.at(i).count;
+            if (sum >= half) {
+                split = i + 1;
+                break;
+            }
+        }
+
+        boxes[target] = measureBox(colors, box.begin, split);
+        boxes.append(measureBox(colors, split, box.end));
+    }
+
+    for (const ColorBox &box : boxes) {
+        qint64 sum[4] = { 0, 0, 0, 0 };
+        for (int i = box.begin; i < box.end; ++i) {
+            const ColorCount &cc = colors.at(i);
+            for (int ch = 0; ch < 4; ++ch)
+                sum[ch] += qint64((cc.color >> channelShifts[ch]) & 0xff) * cc.count;
+        }
+
+        int count = qMax(1, box.count);
+        QRgb color = qRgba(int(sum[1] / count), int(sum[2] / count), int(sum[3] / count), int(sum[0] / count));
+
+        for (int i = box.begin; i < box.end; ++i)
+            indexes.insert(colors.at(i).color, palette.count());
+        palette.append(color);
+    }
+
+    return palette;
+}
+
+int HtmlQuantizer::nearestColor(const QVector<QRgb> &palette, int a, int r, int g, int b)
+{
+    int index = 0;
+    int distance = INT_MAX;
+
+    const QRgb *colors = palette.constData();
+    for (int i = 0, n = palette.count(); i < n; ++i) {
+        int da = qAlpha(colors[i]) - a;
+        int dr = qRed(colors[i]) - r;
+        int dg = qGreen(colors[i]) - g;
+        int db = qBlue(colors[i]) - b;
+        int d = da * da + dr * dr + dg * dg + db * db;
+        if (d < distance) {
+            distance = d;
+            index = i;
+            if (d == 0)
+                break;
+        }
+    }
+
+    return index;
+}
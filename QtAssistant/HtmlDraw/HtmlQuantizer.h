@@ -0,0 +1,18 @@
+﻿#ifndef HTMLQUANTIZER_H
+#define HTMLQUANTIZER_H
+
+#include <QHash>
+#include <QImage>
+#include <QVector>
+
+class HtmlQuantizer
+{
+public:
+    static QImage quantize(const QImage &image, int maxColors = 256, bool dithering = false);
+
+private:
+    static QVector<QRgb> medianCut(const QImage &image, int maxColors, QHash<QRgb, int> &indexes);
+    static int nearestColor(const QVector<QRgb> &palette, int a, int r, int g, int b);
+};
+
+#endif // HTMLQUANTIZER_H
@@ -0,0 +1,98 @@
+﻿#include "HtmlTemplate.h"
+
+#include <QCryptographicHash>
+
+// class HtmlTemplate
+
+HtmlTemplate::HtmlTemplate()
+    : literalSize(0)
+{
+}
+
+HtmlTemplate::HtmlTemplate(const QString &source)
+    : literalSize(0)
+{
+    // 模板只解析一次，拆成文本段和 {{name}} 占位段。
+    int pos = 0;
+    forever {
+        int open = source.indexOf("{{", pos);
+        int close = open < 0 ? -1 : source.indexOf("}}", open + 2);
+        if (close < 0)
+            break;
+
+        QString name = source.mid(open + 2, close - open - 2).trimmed();
+        if (name.isEmpty() || name.contains('{')) {
+            segments.append({ source.mid(pos, open + 2 - pos), false });
+            literalSize += open + 2 - pos;
+            pos = open + 2;
+            continue;
+        }
+
+        if (open > pos) {
+            segments.append({ source.mid(pos, open - pos), false });
+            literalSize += open - pos;
+        }
+
+        segments.append({ name, true });
+        if (!names.contains(name))
+            names.append(name);
+
+        pos = close + 2;
+    }
+
+    if (pos < source.size()) {
+        segments.append({ source.mid(pos), false });
+        literalSize += source.size() - pos;
+    }
+
+    // 摘要只包含静态部分和占位符名称，渲染缓存的键在此基础上加入占位符的值。
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const auto &segment : segments) {
+        const QString &text = segment.text;
+        hash.addData(segment.placeholder ? "\x01" : "\x00", 1);
+        hash.addData(reinterpret_cast<const char *>(text.constData()), text.size() * int(sizeof(QChar)));
+    }
+    staticDigest = hash.result();
+}
+
+bool HtmlTemplate::isEmpty() const
+{
+    return segments.isEmpty();
+}
+
+bool HtmlTemplate::isStatic() const
+{
+    return names.isEmpty();
+}
+
+QStringList HtmlTemplate::placeholders() const
+{
+    return names;
+}
+
+QByteArray HtmlTemplate::digest() const
+{
+    return staticDigest;
+}
+
+QString HtmlTemplate::expand(const QHash<QString, QString> &values) const
+{
+    // 先算出总长度，展开时只分配一次内存。
+    int size = literalSize;
+    for (const auto &segment : segments) {
+        if (segment.placeholder)
+            size += values.value(segment.text).size();
+    }
+
+    QString result;
+    result.reserve(size);
+    for (const auto &segment : segments) {
+        if (segment.placeholder) {
+            result.append(values.value(segment.text));
+        } else {
+            result.append(segment.text);
+        }
+    }
+
+    return result;
+}
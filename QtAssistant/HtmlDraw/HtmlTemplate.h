@@ -0,0 +1,36 @@
+﻿#ifndef HTMLTEMPLATE_H
+#define HTMLTEMPLATE_H
+
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+class HtmlTemplate
+{
+public:
+    HtmlTemplate();
+    explicit HtmlTemplate(const QString &source);
+
+public:
+    bool isEmpty() const;
+    bool isStatic() const;
+
+    QStringList placeholders() const;
+    QByteArray digest() const;
+
+    QString expand(const QHash<QString, QString> &values) const;
+
+private:
+    struct Segment
+    {
+        QString text;
+        bool placeholder;
+    };
+
+    QVector<Segment> segments;
+    QStringList names;
+    QByteArray staticDigest;
+    int literalSize;
+};
+
+#endif // HTMLTEMPLATE_H
@@ -4,11 +4,13 @@ include(SqlDatas/SqlDatas.pri)
 include(HtmlDraw/HtmlDraw.pri)
 
 HEADERS += \
+    $$PWD/AssistantConfig.h \
     $$PWD/AssistantFilters.h \
     $$PWD/AssistantModule.h \
     $$PWD/AssistantModule_p.h
 
 SOURCES += \
+    $$PWD/AssistantConfig.cpp \
     $$PWD/AssistantEvents.cpp \
     $$PWD/AssistantFilters.cpp \
     $$PWD/AssistantModule.cpp \
@@ -0,0 +1,259 @@
+﻿#include "MemberAuditlog.h"
+#include "MemberAuditlog_p.h"
+
+#include <QDateTime>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QLoggingCategory>
+#include <QReadWriteLock>
+
+#include <algorithm>
+#include <limits>
+
+Q_LOGGING_CATEGORY(qlcMemberAuditlog, "Auditlog")
+
+// class MemberAuditlog
+
+MemberAuditlog::MemberAuditlog(QObject *parent)
+    : CoolQ::SqliteService(*new MemberAuditlogPrivate(), parent)
+{
+    Q_D(MemberAuditlog);
+
+    setFileName(QStringLiteral("Auditlog.db"));
+
+    do {
+        const char sql[] = "CREATE TABLE IF NOT EXISTS [Auditlog] ("
+                           "[gid] INT8 NOT NULL, "
+                           "[uid] INT8 NOT NULL, "
+                           "[actor] INT8 NOT NULL, "
+                           "[action] INT4 NOT NULL, "
+                           "[duration] INT8 NOT NULL, "
+                           "[stamp] INT8 NOT NULL, "
+                           "[detail] TEXT);";
+        prepare(QString::fromLatin1(sql));
+    } while (false);
+
+    do {
+        const char sql[] = "CREATE INDEX IF NOT EXISTS [AuditlogGroupStamp] "
+                           "ON [Auditlog] ([gid], [stamp]);";
+        prepare(QString::fromLatin1(sql));
+    } while (false);
+
+    do {
+        const char sql[] = "CREATE INDEX IF NOT EXISTS [AuditlogMemberStamp] "
+                           "ON [Auditlog] ([uid], [stamp]);";
+        prepare(QString::fromLatin1(sql));
+    } while (false);
+
+    openDatabase();
+
+    // 写入缓冲在所属线程中定时批量提交，不占用事件线程。
+    d->flushTimerId = startTimer(2000);
+}
+
+MemberAuditlog::~MemberAuditlog()
+{
+    Q_D(MemberAuditlog);
+
+    killTimer(d->flushTimerId);
+    flush();
+}
+
+void MemberAuditlog::addRecord(qint64 gid, qint64 uid, qint64 actor, Action action,
+                               qint64 duration, const QString &detail)
+{
+    Q_D(MemberAuditlog);
+
+    qint64 stamp = QDateTime::currentDateTime().toMSecsSinceEpoch();
+    Record record{ gid, uid, actor, action, duration, stamp, detail };
+
+    QMutexLocker locker(&d->pendingGuard);
+    d->pending.append(record);
+
+    // 缓冲过多时，提前提交一次。
+    if ((d->pending.count() >= 64) && !d->flushQueued) {
+        d->flushQueued = true;
+        QMetaObject::invokeMethod(this, "flush", Qt::QueuedConnection);
+    }
+}
+
+int MemberAuditlog::pendingCount() const
+{
+    Q_D(const MemberAuditlog);
+
+    QMutexLocker locker(&d->pendingGuard);
+    return d->pending.count();
+}
+
+QList<MemberAuditlog::Record> MemberAuditlog::groupRecords(qint64 gid, qint64 from, qint64 to, int limit)
+{
+    return selectRecords(true, gid, from, to, limit);
+}
+
+QList<MemberAuditlog::Record> MemberAuditlog::memberRecords(qint64 uid, qint64 from, qint64 to, int limit)
+{
+    return selectRecords(false, uid, from, to, limit);
+}
+
+QList<MemberAuditlog::Record> MemberAuditlog::recentRecords(qint64 gid, int limit)
+{
+    return selectRecords(true, gid, 0, std::numeric_limits<qint64>::max(), limit);
+}
+
+CoolQ::SqliteService::Result MemberAuditlog::flush()
+{
+    Q_D(MemberAuditlog);
+    QWriteLocker locker(&d->guard);
+
+    QVector<Record> records;
+    do {
+        QMutexLocker pendingLocker(&d->pendingGuard);
+        records.swap(d->pending);
+        d->flushQueued = false;
+    } while (false);
+
+    if (records.isEmpty()) {
+        return NoChange;
+    }
+
+    transaction();
+
+    const char sql[] = "INSERT INTO [Auditlog] "
+                       "([gid], [uid], [actor], [action], [duration], [stamp], [detail]) "
+                       "VALUES(?, ?, ?, ?, ?, ?, ?);";
+    QSqlQuery query = prepareQuery(sql);
+    for (const auto &record : records) {
+        query.addBindValue(record.gid);
+        query.addBindValue(record.uid);
+        query.addBindValue(record.actor);
+        query.addBindValue(record.action);
+        query.addBindValue(record.duration);
+        query.addBindValue(record.stamp);
+        query.addBindValue(record.detail);
+        if (!query.exec()) {
+            qCCritical(qlcMemberAuditlog, "Insert error: %s",
+                       qPrintable(query.lastError().text()));
+            rollback();
+
+            // 放回缓冲，等待下次提交。
+            d->requeue(records);
+            return SqlError;
+        }
+    }
+
+    if (!commit()) {
+        qCCritical(qlcMemberAuditlog, "Commit error.");
+        rollback();
+
+        d->requeue(records);
+        return SqlError;
+    }
+
+    qCDebug(qlcMemberAuditlog, "Flush: %d records.", records.count());
+
+    do {
+        QMutexLocker pendingLocker(&d->pendingGuard);
+        if (d->droppedCount > 0) {
+            qCWarning(qlcMemberAuditlog, "Recovered; %d records were dropped.", d->droppedCount);
+            d->droppedCount = 0;
+        }
+    } while (false);
+
+    return Done;
+}
+
+QList<MemberAuditlog::Record> MemberAuditlog::selectRecords(bool byGroup, qint64 id, qint64 from, qint64 to, int limit)
+{
+    Q_D(MemberAuditlog);
+    QWriteLocker locker(&d->guard);
+
+    QList<Record> records;
+
+    // 尚未提交的记录最新，优先返回。
+    do {
+        QMutexLocker pendingLocker(&d->pendingGuard);
+        for (int i = d->pending.count() - 1; i >= 0; --i) {
+            const Record &record = d->pending.at(i);
+            if ((byGroup ? record.gid : record.uid) != id)
+                continue;
+            if ((record.stamp < from) || (record.stamp >= to))
+                continue;
+            records.append(record);
+        }
+    } while (false);
+
+    std::stable_sort(records.begin(), records.end(), [](const Record &a, const Record &b) {
+        return a.stamp > b.stamp;
+    });
+
+    if (records.count() >= limit) {
+        return records.mid(0, limit);
+    }
+
+    const char groupSql[] = "SELECT [gid], [uid], [actor], [action], [duration], [stamp], [detail] "
+                            "FROM [Auditlog] WHERE [gid] = ? AND [stamp] >= ? AND [stamp] < ? "
+                            "ORDER BY [stamp] DESC LIMIT ?;";
+    const char memberSql[] = "SELECT [gid], [uid], [actor], [action], [duration], [stamp], [detail] "
+                             "FROM [Auditlog] WHERE [uid] = ? AND [stamp] >= ? AND [stamp] < ? "
+                             "ORDER BY [stamp] DESC LIMIT ?;";
+
+    QSqlQuery query = prepareQuery(byGroup ? groupSql : memberSql);
+    query.addBindValue(id);
+    query.addBindValue(from);
+    query.addBindValue(to);
+    query.addBindValue(limit - records.count());
+    if (!query.exec()) {
+        qCCritical(qlcMemberAuditlog, "Select error: %s",
+                   qPrintable(query.lastError().text()));
+        return records;
+    }
+
+    while (query.next()) {
+        Record record;
+        record.gid = query.value(0).toLongLong();
+        record.uid = query.value(1).toLongLong();
+        record.actor = query.value(2).toLongLong();
+        record.action = query.value(3).toInt();
+        record.duration = query.value(4).toLongLong();
+        record.stamp = query.value(5).toLongLong();
+        record.detail = query.value(6).toString();
+        records.append(record);
+    }
+
+    return records;
+}
+
+void MemberAuditlog::timerEvent(QTimerEvent *)
+{
+    flush();
+}
+
+// class MemberAuditlogPrivate
+
+MemberAuditlogPrivate::MemberAuditlogPrivate()
+    : flushQueued(false)
+    , droppedCount(0)
+    , flushTimerId(-1)
+{
+}
+
+MemberAuditlogPrivate::~MemberAuditlogPrivate()
+{
+}
+
+void MemberAuditlogPrivate::requeue(const QVector<MemberAuditlog::Record> &records)
+{
+    static const int maxPending = 4096;
+
+    QMutexLocker locker(&pendingGuard);
+    pending = records + pending;
+
+    // 只在开始丢弃时记录一次日志，恢复写入后再报告总数。
+    int overflow = pending.count() - maxPending;
+    if (overflow > 0) {
+        if (droppedCount == 0)
+            qCWarning(qlcMemberAuditlog, "Database unwritable; dropping oldest records beyond %d.", maxPending);
+        pending.remove(0, overflow);
+        droppedCount += overflow;
+    }
+}
@@ -0,0 +1,63 @@
+﻿#ifndef MEMBERAUDITLOG_H
+#define MEMBERAUDITLOG_H
+
+#include <QList>
+
+#include "CoolQSqliteService.h"
+
+class MemberAuditlogPrivate;
+class MemberAuditlog : public CoolQ::SqliteService
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(MemberAuditlog)
+
+public:
+    explicit MemberAuditlog(QObject *parent = Q_NULLPTR);
+    virtual ~MemberAuditlog();
+
+public:
+    enum Action {
+        Ban = 1,
+        Unban,
+        Kick,
+        Rename,
+        AddWatchlist,
+        RemoveWatchlist,
+        AddBlacklist,
+        RemoveBlacklist,
+        RejectRequest,
+    };
+    Q_ENUM(Action)
+
+    struct Record
+    {
+        qint64 gid;
+        qint64 uid;
+        qint64 actor;
+        qint32 action;
+        qint64 duration;
+        qint64 stamp;
+        QString detail;
+    };
+
+public:
+    void addRecord(qint64 gid, qint64 uid, qint64 actor, Action action,
+                   qint64 duration = 0, const QString &detail = QString());
+
+public:
+    QList<Record> groupRecords(qint64 gid, qint64 from, qint64 to, int limit);
+    QList<Record> memberRecords(qint64 uid, qint64 from, qint64 to, int limit);
+    QList<Record> recentRecords(qint64 gid, int limit);
+
+public:
+    int pendingCount() const;
+
+public slots:
+    Result flush();
+
+private:
+    QList<Record> selectRecords(bool byGroup, qint64 id, qint64 from, qint64 to, int limit);
+    void timerEvent(QTimerEvent *) Q_DECL_FINAL;
+};
+
+#endif // MEMBERAUDITLOG_H
@@ -0,0 +1,32 @@
+﻿#ifndef MEMBERAUDITLOG_P_H
+#define MEMBERAUDITLOG_P_H
+
+#include <QMutex>
+#include <QVector>
+
+#include "CoolQSqliteService_p.h"
+#include "MemberAuditlog.h"
+
+class MemberAuditlogPrivate : public CoolQ::SqliteServicePrivate
+{
+    Q_DECLARE_PUBLIC(MemberAuditlog)
+
+public:
+    MemberAuditlogPrivate();
+    virtual ~MemberAuditlogPrivate();
+
+public:
+    void requeue(const QVector<MemberAuditlog::Record> &records);
+
+public:
+    mutable QMutex pendingGuard;
+    QVector<MemberAuditlog::Record> pending;
+    bool flushQueued;
+
+    // 数据库无法写入时缓冲的上限，超出时丢弃最旧的记录。
+    int droppedCount;
+
+    int flushTimerId;
+};
+
+#endif // MEMBERAUDITLOG_P_H
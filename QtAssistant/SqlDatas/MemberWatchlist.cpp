@@ -113,7 +113,8 @@ bool MemberWatchlist::contains(qint64 gid, qint64 uid) const
     return d->members.contains(CoolQ::Member(gid, uid));
 }
 
-void MemberWatchlist::expiredMembers(CoolQ::MemberList &members)
+// timeout 按群号给出观察时长，单位为毫秒。
+void MemberWatchlist::expiredMembers(CoolQ::MemberList &members, const std::function<qint64(qint64)> &timeout)
 {
     Q_D(MemberWatchlist);
     QWriteLocker locker(&d->guard);
@@ -122,7 +123,7 @@ void MemberWatchlist::expiredMembers(CoolQ::MemberList &members)
     QMutableHashIterator<CoolQ::Member, qint64> iter(d->members);
     while (iter.hasNext()) {
         iter.next();
-        if ((iter.value() + 1800000) < now) {
+        if ((iter.value() + timeout(iter.key().first)) < now) {
             members << iter.key();
             iter.remove();
         }
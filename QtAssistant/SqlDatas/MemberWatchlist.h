@@ -3,6 +3,8 @@
 
 #include <QHash>
 
+#include <functional>
+
 #include "CoolQSqliteService.h"
 
 class MemberWatchlistPrivate;
@@ -23,7 +25,7 @@ public:
     QHash<CoolQ::Member, qint64> members() const;
     bool contains(qint64 gid, qint64 uid) const;
 
-    void expiredMembers(CoolQ::MemberList &members);
+    void expiredMembers(CoolQ::MemberList &members, const std::function<qint64(qint64)> &timeout);
 };
 
 #endif // MEMBERWATCHLIST_H
@@ -1,9 +1,12 @@
 HEADERS += \
+    $$PWD/MemberAuditlog.h \
+    $$PWD/MemberAuditlog_p.h \
     $$PWD/MemberBlacklist.h \
     $$PWD/MemberBlacklist_p.h \
     $$PWD/MemberWatchlist.h \
     $$PWD/MemberWatchlist_p.h
 
 SOURCES += \
+    $$PWD/MemberAuditlog.cpp \
     $$PWD/MemberWatchlist.cpp \
     $$PWD/MemberBlacklist.cpp
@@ -0,0 +1,12 @@
+QT      -= gui
+CONFIG  += console
+CONFIG  -= app_bundle
+TEMPLATE = app
+
+TARGET   = FlightDecoder
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+DESTDIR  = $$PWD/../../bin
+
+SOURCES += main.cpp
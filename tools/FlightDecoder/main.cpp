@@ -0,0 +1,114 @@
+﻿#include <QtCore>
+
+// 解码 CoolQ::FlightRecorder 写出的 .cqfr 文件，每条记录输出一行。
+
+namespace {
+
+enum Kind {
+    Event = 1,
+    Dispatch,
+    Handler,
+    Api
+};
+
+QVector<QByteArray> readNames(QDataStream &ds)
+{
+    quint32 count = 0;
+    ds >> count;
+
+    QVector<QByteArray> names;
+    for (quint32 i = 0; i < count && ds.status() == QDataStream::Ok; ++i) {
+        quint16 size = 0;
+        ds >> size;
+        QByteArray name(size, Qt::Uninitialized);
+        ds.readRawData(name.data(), size);
+        names.append(name);
+    }
+
+    return names;
+}
+
+QByteArray nameOf(const QVector<QByteArray> &names, quint16 code)
+{
+    return code < names.count() ? names.at(code) : QByteArray("#") + QByteArray::number(code);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (app.arguments().count() < 2) {
+        err << "Usage: FlightDecoder <file.cqfr>" << endl;
+        return 1;
+    }
+
+    QFile file(app.arguments().at(1));
+    if (!file.open(QIODevice::ReadOnly)) {
+        err << "Cannot open " << file.fileName() << ": " << file.errorString() << endl;
+        return 1;
+    }
+
+    QDataStream ds(&file);
+    ds.setByteOrder(QDataStream::LittleEndian);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint16 reserved = 0;
+    qint64 epoch = 0;
+    ds >> magic >> version >> reserved >> epoch;
+    if (magic != 0x52465143 || version != 1) {
+        err << file.fileName() << " is not a flight record" << endl;
+        return 1;
+    }
+
+    QVector<QByteArray> events = readNames(ds);
+    QVector<QByteArray> apis = readNames(ds);
+    QVector<QByteArray> handlers = readNames(ds);
+
+    quint32 count = 0;
+    ds >> count;
+
+    QDateTime start = QDateTime::fromMSecsSinceEpoch(epoch);
+    out << "# started " << start.toString(Qt::ISODate) << ", " << count << " records" << endl;
+
+    for (quint32 i = 0; i < count; ++i) {
+        quint16 kind, code;
+        quint32 value;
+        qint64 stamp, from, arg;
+        ds >> kind >> code >> value >> stamp >> from >> arg;
+        if (ds.status() != QDataStream::Ok) {
+            err << "Truncated at record " << i << endl;
+            return 1;
+        }
+
+        QString time = start.addMSecs(stamp / 1000).toString("HH:mm:ss.zzz")
+                + QString("%1").arg(stamp % 1000, 3, 10, QLatin1Char('0'));
+
+        out << time << ' ';
+        switch (kind) {
+        case Event:
+            out << "event    " << nameOf(events, code) << " from=" << from << " actor=" << arg;
+            break;
+        case Dispatch:
+            out << "dispatch " << nameOf(events, code) << " from=" << from
+                << (arg ? " blocked" : " passed") << ' ' << value << "us";
+            break;
+        case Handler:
+            out << "handler  " << nameOf(handlers, code) << " from=" << from << ' ' << value << "us";
+            break;
+        case Api:
+            out << "api      " << nameOf(apis, code) << " result=" << arg << ' ' << value << "us";
+            break;
+        default:
+            out << "unknown  kind=" << kind << " code=" << code;
+            break;
+        }
+        out << endl;
+    }
+
+    return 0;
+}